@@ -0,0 +1,147 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   adc.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Interrupt driven ADC scan engine
+ *
+ * The ADC cycles through a fixed scan sequence. Every 4th slot samples a
+ * sensor (hall and NTC alternating), all other slots sample the zero crossing
+ * input. Zero crossing samples go straight to the detector, hall samples are
+ * published into a small ring buffer, so readers never have to wait for a
+ * conversion. Zero crossing and NTC samples have no ring buffer: nothing reads
+ * their raw history, and every store here costs cycles in the handler that
+ * dominates the CPU load at 1 MHz.
+ *
+ * Each conversion is started by the interrupt of the previous one, right
+ * after selecting the channel of the next slot. A handler delayed by other
+ * interrupts therefore only delays the scan, a sample is never processed
+ * under the channel of another slot (as in free running mode, where the
+ * multiplexer has to be set one conversion ahead).
+ *
+ * NTC samples are additionally summed up in groups of ADC_OVERSAMPLING and
+ * decimated to 12 bit (oversampling by 4^2 for 2 extra bits, the ADC noise
+ * acts as dither).
+ */
+
+#include "hal.h"
+#include "main.h"
+#include "adc.h"
+#include "zerocross.h"
+
+// variables:
+volatile unsigned int adc_buffer[ADC_BUFFER_SIZE];                 // Hall sample ring buffer.
+volatile unsigned char adc_head;                                    // Index of latest hall sample.
+static unsigned char adc_slot;                                      // Scan slot of the completing conversion.
+volatile unsigned int adc_decimated;                                // Oversampled 12 bit NTC value.
+volatile unsigned char adc_decimations;                             // Number of decimated values (wrapping).
+static unsigned int adc_sum;                                        // Sum of pending NTC samples.
+static unsigned char adc_samples;                                   // Number of pending NTC samples.
+static unsigned char adc_wakeup;                                    // Publish the next NTC sample on its own.
+
+// Multiplexer setting for each logical channel (in flash, const data would be copied to SRAM).
+static const unsigned char adc_mux[ADC_CHANNELS] PROGMEM = {ZERO_CROSSING_adc, SENSOR_MAGNET_adc, SENSOR_TEMP_adc};
+
+/**
+ * Map a scan slot to its logical channel.
+ *
+ * @param slot Scan slot (only the lower 3 bits are evaluated).
+ * @return Logical channel.
+ */
+static unsigned char adc_channel(unsigned char slot) {
+    if ((slot & 3) != 3) {
+        return ADC_ZERO;
+    }
+    return (slot & 4) ? ADC_TEMP : ADC_MAGNET;
+}
+
+/**
+ * Enable the ADC and start the scan sequence.
+ */
+void adc_init(void) {
+    adc_slot = 0;
+    ADMUX = pgm_read_byte(&adc_mux[adc_channel(0)]);
+    ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADIE) | ADC_PRESCALER;
+}
+
+/**
+ * Stop the ADC before power-down, it would keep drawing current.
+ */
+void adc_sleep(void) {
+    ADCSRA = 0;
+}
+
+/**
+ * Restart the scan and the NTC oversampling, samples from before sleep are outdated.
+ * The first sample is published right away (scaled to 12 bit), so the boiler
+ * controller does not wait for a full group. Call with interrupts disabled.
+ */
+void adc_wake(void) {
+    adc_sum = 0;
+    adc_samples = 0;
+    adc_wakeup = 1;
+    adc_init();
+}
+
+/**
+ * Get latest sample of the hall sensor.
+ * A slot is only rewritten after ADC_BUFFER_SIZE further conversions, so no locking is required.
+ *
+ * @return Raw 10 bit ADC value.
+ */
+unsigned int adc_magnet(void) {
+    return adc_buffer[adc_head];
+}
+
+/**
+ * ADC conversion complete. Starts the conversion of the next slot, then stores the sample.
+ */
+ISR ( ADC_vect) {
+    unsigned char sense_L = ADCL;
+    unsigned char sense_H = ADCH;
+    unsigned char channel = adc_channel(adc_slot);
+
+    adc_slot = (adc_slot + 1) & (ADC_SCAN_SLOTS - 1);
+    ADMUX = pgm_read_byte(&adc_mux[adc_channel(adc_slot)]);
+    set_bit(ADCSRA, ADSC);                                          // Next conversion runs while this one is processed.
+
+    unsigned int value = (sense_H << 8) | sense_L;
+    if (channel == ADC_ZERO) {
+        zc_sample(value);
+    } else if (channel == ADC_MAGNET) {
+        unsigned char head = (adc_head + 1) & (ADC_BUFFER_SIZE - 1);
+        adc_buffer[head] = value;
+        adc_head = head;
+    } else {
+        if (adc_wakeup) {                                           // Counts for a whole group.
+            adc_wakeup = 0;
+            value *= ADC_OVERSAMPLING;
+            adc_samples = ADC_OVERSAMPLING - 1;
+        }
+        adc_sum += value;
+        if (++adc_samples == ADC_OVERSAMPLING) {
+            adc_decimated = adc_sum >> 2;
+            adc_decimations++;
+            adc_sum = 0;
+            adc_samples = 0;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   adc.h
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Interrupt driven ADC scan engine
+ */
+
+#ifndef ADC_H
+#define ADC_H
+
+// Logical ADC channels.
+#define ADC_ZERO            0       // Zero crossing detection.
+#define ADC_MAGNET          1       // Hall switch (water).
+#define ADC_TEMP            2       // NTC (temperature).
+#define ADC_CHANNELS        3
+
+#define ADC_BUFFER_SIZE     4       // Buffered hall samples (power of 2).
+#define ADC_SCAN_SLOTS      8       // Length of the scan sequence (power of 2).
+#define ADC_OVERSAMPLING    16      // NTC samples per decimated 12 bit value.
+
+// Fastest ADC clock within ADC_CLOCK_MAX for full resolution, with a prescaler of at least 16.
+// A scan slot then takes at least 224 cycles, less than the longest interrupt handler at 1 MHz.
+// Conversions are started by the handler, so a late handler delays the scan but never mixes up
+// channels. The zero crossing sample gap is kept within the mains zero window by the handler
+// budgets in bench/limits.txt.
+#define ADC_CLOCK_MAX       200000UL
+#define ADC_CLOCK_MIN       50000UL
+#if F_CPU / 16 <= ADC_CLOCK_MAX
+#define ADC_DIVISION        16
+#define ADC_PRESCALER       ((1 << ADPS2))
+#elif F_CPU / 32 <= ADC_CLOCK_MAX
+#define ADC_DIVISION        32
+#define ADC_PRESCALER       ((1 << ADPS2) | (1 << ADPS0))
+#elif F_CPU / 64 <= ADC_CLOCK_MAX
+#define ADC_DIVISION        64
+#define ADC_PRESCALER       ((1 << ADPS2) | (1 << ADPS1))
+#else
+#define ADC_DIVISION        128
+#define ADC_PRESCALER       ((1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0))
+#endif
+#if F_CPU / ADC_DIVISION > ADC_CLOCK_MAX || F_CPU / ADC_DIVISION < ADC_CLOCK_MIN
+#error "F_CPU: ADC clock out of range"
+#endif
+#define ADC_CONVERSION_US   (14 * ADC_DIVISION / (F_CPU / 1000000UL))   // Time per slot (13 clocks, started on the next clock edge).
+
+extern volatile unsigned int adc_buffer[ADC_BUFFER_SIZE];
+extern volatile unsigned char adc_head;
+extern volatile unsigned int adc_decimated;
+extern volatile unsigned char adc_decimations;
+
+// Prototypes:
+void adc_init(void);                            //  Start scan.
+void adc_sleep(void);                           //  Stop ADC before power-down.
+unsigned int adc_magnet(void);                  //  Latest 10 bit hall sample.
+void adc_wake(void);                            //  Restart scan, drop NTC samples from before sleep.
+
+#endif
@@ -0,0 +1,350 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   bench.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Cycle accurate benchmark on simavr
+ *
+ * Runs the benchmark build of the firmware (BENCH defined, main loop marker
+ * on PB2, supervisor marker on PB0) instruction by instruction and reports:
+ *   - worst case and average cycles of each interrupt handler
+ *   - worst case and average cycles of the supervisor per timer tick
+ *   - main loop period per phase (heating, ready, brewing)
+ *   - latency from 1-cup button push to the first pump gate
+ *   - latency from the wake-up push of the power button to the first boiler gate
+ *   - average supply current per phase, from the time spent active, in idle
+ *     and in power-down (typical currents at F_CPU and 5 V)
+ *   - CPU load per phase (share of active cycles, the rest is headroom)
+ *   - zero crossing resolution (longest gap between samples of the mains input,
+ *     not counting power-down)
+ *   - phase and jitter of the pump gate relative to the mains zero crossing
+ *
+ * Results are printed as "key=value" lines. With a limits file (lines of
+ * "key max"), every result above its limit is reported and the exit status
+ * is non-zero.
+ *
+ * Usage: bench FIRMWARE.elf MCU [LIMITS]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/avr_adc.h>
+#include <simavr/avr_ioport.h>
+
+#ifndef F_CPU
+#define F_CPU           1000000UL   // Clock of the benchmark build (make passes F_CPU).
+#endif
+#define CPU_MHZ         (F_CPU / 1000000UL)
+#define MAINS_HZ        50.0
+#define SREG_I          7           // Global interrupt enable bit.
+#define VECTORS         19          // ATtiny861A interrupt vectors (1 word each).
+#define MARKER_PIN      2           // Main loop marker (PB2/SCK).
+#define PROBE_PIN       0           // Supervisor marker (PB0/MOSI, high while running).
+#define PUMP_PIN        7           // Pump triac (PA7, active low).
+#define BOILER_PIN      6           // Boiler triac (PA6, active low).
+#define MCUCR           0x55        // MCUCR data address (sleep mode in SM1:SM0).
+#define MCUCR_SM0       3
+
+// CPU states and their supply current (uA), typical at 5 V and about linear in the clock.
+enum { CPU_ACTIVE, CPU_IDLE, CPU_POWER_DOWN, CPU_STATES };
+static const double cpu_ua[CPU_STATES] = {600 + 1400 * CPU_MHZ, 300 + 300 * CPU_MHZ, 1};
+
+#define MS(t)           ((avr_cycle_count_t) (t) * (F_CPU / 1000))
+
+static const char *vector_names[VECTORS] = {
+    "reset", "int0", "pcint", "timer1_compa", "timer1_compb", "timer1_ovf",
+    "timer0_ovf", "usi_start", "usi_ovf", "ee_rdy", "ana_comp", "adc",
+    "wdt", "int1", "timer0_compa", "timer0_compb", "timer0_capt", "timer1_compd", "fault_protection"
+};
+
+// Benchmark phases (scripted inputs).
+enum { PHASE_OFF, PHASE_HEATING, PHASE_READY, PHASE_BREWING, PHASES };
+static const char *phase_names[PHASES] = {"off", "heating", "ready", "brewing"};
+
+static avr_t *avr;
+static unsigned char phase;
+static double ntc_mv;                           // NTC input voltage.
+
+static struct {
+    unsigned long count;
+    unsigned long long total;
+    unsigned long max;
+} isr[VECTORS], loop[PHASES], supervisor;
+static avr_cycle_count_t cpu[PHASES][CPU_STATES];  // Cycles per phase and CPU state.
+
+static avr_cycle_count_t marker_last;           // Last main loop marker.
+static avr_cycle_count_t probe_start;           // Supervisor entered.
+static avr_cycle_count_t press_cycle;           // 1-cup button pushed.
+static long latency = -1;                       // Push to first gate (cycles).
+static avr_cycle_count_t wake_cycle;            // Power button pushed.
+static long wake_latency = -1;                  // Push to first boiler gate (cycles).
+static double gate_min = 1e9, gate_max = -1e9;  // Gate offset to zero crossing (us).
+static avr_cycle_count_t zero_last;             // Last zero crossing conversion started.
+static avr_cycle_count_t zero_gap;              // Longest gap between zero crossing conversions.
+static unsigned char pump_last = 1;
+static unsigned char boiler_last = 1;
+
+static void account(unsigned long *count, unsigned long long *total, unsigned long *max, unsigned long value) {
+    (*count)++;
+    *total += value;
+    if (value > *max) {
+        *max = value;
+    }
+}
+
+/**
+ * ADC conversion started: provide the input voltage of the selected channel.
+ */
+static void adc_trigger(struct avr_irq_t *irq, uint32_t value, void *param) {
+    (void) irq;
+    (void) param;
+    union {
+        avr_adc_mux_t mux;
+        uint32_t v;
+    } e = {.v = value};
+    double mv = 0;
+
+    if (e.mux.src == 0) {               // Rectified mains, 1:1 divider, 5V1 zener.
+        if (zero_last && phase != PHASE_OFF && avr->cycle - zero_last > zero_gap) {
+            zero_gap = avr->cycle - zero_last;
+        }
+        zero_last = avr->cycle;
+        double t = (double) avr->cycle / F_CPU;
+        mv = (9500.0 * fabs(sin(2 * M_PI * MAINS_HZ * t)) - 1400.0) / 2;
+        mv = mv < 0 ? 0 : mv > 5100 ? 5100 : mv;
+    } else if (e.mux.src == 4) {        // Hall switch: tank full.
+        mv = 4000;
+    } else if (e.mux.src == 3) {        // NTC.
+        mv = ntc_mv;
+    }
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0 + e.mux.src), (uint32_t) mv);
+}
+
+/**
+ * Port B written: main loop and supervisor marker.
+ */
+static void port_b(struct avr_irq_t *irq, uint32_t value, void *param) {
+    (void) irq;
+    (void) param;
+    static unsigned char last, probe_last;
+    unsigned char probe = (value >> PROBE_PIN) & 1;
+    if (probe && !probe_last) {
+        probe_start = avr->cycle;
+    } else if (!probe && probe_last && probe_start) {
+        account(&supervisor.count, &supervisor.total, &supervisor.max, avr->cycle - probe_start);
+    }
+    probe_last = probe;
+
+    unsigned char marker = (value >> MARKER_PIN) & 1;
+    if (marker != last) {
+        last = marker;
+        if (marker_last) {
+            account(&loop[phase].count, &loop[phase].total, &loop[phase].max, avr->cycle - marker_last);
+        }
+        marker_last = avr->cycle;
+    }
+}
+
+/**
+ * Port A written: pump and boiler gate.
+ */
+static void port_a(struct avr_irq_t *irq, uint32_t value, void *param) {
+    (void) irq;
+    (void) param;
+    unsigned char pump = (value >> PUMP_PIN) & 1;
+    if (pump_last && !pump) {                   // Gate asserted.
+        if (press_cycle && latency < 0) {
+            latency = avr->cycle - press_cycle;
+        }
+        if (phase == PHASE_BREWING && latency >= 0) {
+            double t = (double) avr->cycle / F_CPU * 2 * MAINS_HZ;
+            double offset = (t - round(t)) / (2 * MAINS_HZ) * 1e6;
+            gate_min = offset < gate_min ? offset : gate_min;
+            gate_max = offset > gate_max ? offset : gate_max;
+        }
+    }
+    pump_last = pump;
+
+    unsigned char boiler = (value >> BOILER_PIN) & 1;
+    if (boiler_last && !boiler && wake_cycle && wake_latency < 0) {
+        wake_latency = avr->cycle - wake_cycle;
+    }
+    boiler_last = boiler;
+}
+
+static void button(unsigned char pin, unsigned char pushed) {
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), pin), !pushed);
+}
+
+/**
+ * Run until the given time, measuring interrupt handlers and sleep.
+ */
+static void run_until(avr_cycle_count_t until) {
+    static int vector = -1;
+    static avr_cycle_count_t entry;
+    while (avr->cycle < until) {
+        avr_cycle_count_t start = avr->cycle;
+        int cpu_state = CPU_ACTIVE;
+        if (avr->state == cpu_Sleeping) {
+            cpu_state = ((avr->data[MCUCR] >> MCUCR_SM0) & 3) >= 2 ? CPU_POWER_DOWN : CPU_IDLE;
+        }
+        int state = avr_run(avr);
+        cpu[phase][cpu_state] += avr->cycle - start;
+        if (state == cpu_Done || state == cpu_Crashed) {
+            fprintf(stderr, "MCU stopped (state %d)\n", state);
+            exit(2);
+        }
+        if (vector < 0 && !avr->sreg[SREG_I] && avr->pc < 2 * VECTORS && avr->pc > 0) {
+            vector = avr->pc / 2;               // Vector entered (4 cycles response time).
+            entry = avr->cycle - 4;
+        } else if (vector >= 0 && avr->sreg[SREG_I]) {
+            account(&isr[vector].count, &isr[vector].total, &isr[vector].max, avr->cycle - entry);
+            vector = -1;
+        }
+    }
+}
+
+static int failed;
+
+/**
+ * Print a result and compare it against the limits file.
+ */
+static void result(FILE *limits, const char *key, double value) {
+    printf("%s=%.1f\n", key, value);
+    if (!limits) {
+        return;
+    }
+    char line[128], name[96];
+    double max;
+    rewind(limits);
+    while (fgets(line, sizeof(line), limits)) {
+        if (sscanf(line, "%95s %lf", name, &max) == 2 && name[0] != '#' && !strcmp(name, key) && value > max) {
+            printf("FAIL=%s %.1f > %.1f\n", key, value, max);
+            failed++;
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s FIRMWARE.elf MCU [LIMITS]\n", argv[0]);
+        return 2;
+    }
+
+    elf_firmware_t firmware;
+    memset(&firmware, 0, sizeof(firmware));
+    if (elf_read_firmware(argv[1], &firmware)) {
+        fprintf(stderr, "Unable to read %s\n", argv[1]);
+        return 2;
+    }
+    avr = avr_make_mcu_by_name(argv[2]);
+    if (!avr) {
+        fprintf(stderr, "simavr has no core for %s\n", argv[2]);
+        return 2;
+    }
+    avr_init(avr);
+    avr_load_firmware(avr, &firmware);
+    avr->frequency = F_CPU;
+
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_OUT_TRIGGER), adc_trigger, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('A'), IOPORT_IRQ_REG_PORT), port_a, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), IOPORT_IRQ_REG_PORT), port_b, NULL);
+    button(4, 0);
+    button(5, 0);
+    button(6, 0);
+    ntc_mv = 1000;                              // Cold boiler.
+
+    // Script: wake up, heat, ready, brew one coffee.
+    run_until(MS(100));
+    wake_cycle = avr->cycle;
+    button(6, 1);
+    run_until(MS(150));
+    button(6, 0);
+    phase = PHASE_HEATING;
+    run_until(MS(2000));
+    ntc_mv = 2600;                              // Above operating temperature.
+    phase = PHASE_READY;
+    run_until(MS(4000));
+    press_cycle = avr->cycle;
+    button(4, 1);
+    run_until(MS(4200));
+    button(4, 0);
+    phase = PHASE_BREWING;
+    run_until(MS(8000));
+
+    FILE *limits = argc > 3 ? fopen(argv[3], "r") : NULL;
+    char key[64];
+    for (int v = 0; v < VECTORS; v++) {
+        if (isr[v].count) {
+            snprintf(key, sizeof(key), "isr.%s.max_cycles", vector_names[v]);
+            result(limits, key, isr[v].max);
+            snprintf(key, sizeof(key), "isr.%s.avg_cycles", vector_names[v]);
+            result(limits, key, (double) isr[v].total / isr[v].count);
+            snprintf(key, sizeof(key), "isr.%s.cpu_percent", vector_names[v]);
+            result(limits, key, 100.0 * isr[v].total / avr->cycle);
+        }
+    }
+    if (supervisor.count) {
+        result(limits, "supervisor.max_cycles", supervisor.max);
+        result(limits, "supervisor.avg_cycles", (double) supervisor.total / supervisor.count);
+    }
+    for (int p = PHASE_HEATING; p < PHASES; p++) {
+        if (loop[p].count) {
+            snprintf(key, sizeof(key), "loop.%s.max_cycles", phase_names[p]);
+            result(limits, key, loop[p].max);
+            snprintf(key, sizeof(key), "loop.%s.avg_cycles", phase_names[p]);
+            result(limits, key, (double) loop[p].total / loop[p].count);
+        }
+    }
+    for (int p = PHASE_HEATING; p < PHASES; p++) {
+        double charge = 0, cycles = 0;
+        for (int c = 0; c < CPU_STATES; c++) {
+            charge += cpu_ua[c] * cpu[p][c];
+            cycles += cpu[p][c];
+        }
+        snprintf(key, sizeof(key), "power.%s_ua", phase_names[p]);
+        result(limits, key, cycles ? charge / cycles : 0);
+        snprintf(key, sizeof(key), "cpu.%s_load_percent", phase_names[p]);
+        result(limits, key, cycles ? 100.0 * cpu[p][CPU_ACTIVE] / cycles : 0);
+    }
+    result(limits, "zero_cross.resolution_us", (double) zero_gap / CPU_MHZ);
+    result(limits, "latency.button_to_pump_ms", latency < 0 ? -1 : latency / (F_CPU / 1000.0));
+    result(limits, "latency.wake_to_boiler_ms", wake_latency < 0 ? -1 : wake_latency / (F_CPU / 1000.0));
+    result(limits, "pump_gate.offset_min_us", gate_min);
+    result(limits, "pump_gate.jitter_us", gate_max - gate_min);
+    if (latency < 0) {
+        printf("FAIL=no pump gate\n");
+        failed++;
+    }
+    if (wake_latency < 0) {
+        printf("FAIL=no boiler gate\n");
+        failed++;
+    }
+    if (!supervisor.count) {
+        printf("FAIL=no supervisor marker\n");
+        failed++;
+    }
+    return failed ? 1 : 0;
+}
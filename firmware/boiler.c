@@ -0,0 +1,189 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   boiler.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Closed loop boiler temperature control
+ *
+ * A fixed point PID controller with feed-forward computes the boiler duty
+ * cycle every BOILER_PERIOD half-cycles. The derivative term acts on the
+ * temperature slope from ntc.c, so heating is cut back before the lagging
+ * sensor reaches the setpoint. The duty cycle is applied as burst
+ * modulation: a first order sigma-delta modulator decides on every full mains
+ * cycle whether the triac conducts, so the boiler is only switched at zero
+ * crossings and never draws a DC component.
+ *
+ * While the pump runs, the feed-forward is raised by up to BREW_FF (in
+ * proportion to the pump duty) for the cold water flowing in, and the duty
+ * cycle is limited so that pump and boiler together stay within
+ * LOAD_DUTY_MAX.
+ */
+
+#include "hal.h"
+#include "main.h"
+#include "boiler.h"
+#include "ntc.h"
+#include "trace.h"
+#include "triac.h"
+
+// variables:
+volatile unsigned char boiler_duty;             // Current duty cycle (0..255).
+volatile unsigned char boiler_halves;           // Half-cycles with boiler on (wrapping).
+static volatile unsigned char boiler_on;        // Heating enabled.
+static unsigned int boiler_setpoint = OPERATING_TEMPERATURE << NTC_FRAC;    // Target temperature (1/16 °C).
+static volatile unsigned char boiler_cycles;    // Half-cycles since last controller run.
+static unsigned char boiler_phase;              // Half-cycle within full cycle.
+static unsigned char boiler_sigma;              // Modulator accumulator.
+#if BOILER_PID
+static int boiler_integral;                     // Integral term (fixed point).
+#endif
+
+/**
+ * Enable or disable heating. Enabling runs the controller on the next
+ * temperature and switches on at the next zero crossing, disabling switches
+ * the triac off immediately.
+ *
+ * @param on Non-zero to enable closed loop heating.
+ */
+void boiler_enable(unsigned char on) {
+    if (on && !boiler_on) {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            boiler_cycles = BOILER_PERIOD;
+            boiler_phase = 1;                           // Next crossing starts a full cycle.
+        }
+    }
+    boiler_on = on;
+    if (!on) {
+        boiler_duty = 0;
+#if BOILER_PID
+        boiler_integral = 0;
+#endif
+#if TRACE & TRACE_BOILER
+        if (!is_set(TRIAC_BOILER_w, TRIAC_BOILER_pin)) {
+            trace_put(TR_BOILER, 0);
+        }
+#endif
+        set_bit(TRIAC_BOILER_w, TRIAC_BOILER_pin);      // Boiler off.
+    }
+}
+
+/**
+ * Set the target temperature.
+ *
+ * @param setpoint Temperature in 1/16 °C.
+ */
+void boiler_set(unsigned int setpoint) {
+    boiler_setpoint = setpoint;
+}
+
+/**
+ * Run the temperature controller. Returns immediately unless BOILER_PERIOD half-cycles have passed.
+ *
+ * @param temperature Filtered temperature in 1/16 °C.
+ * @param slope Temperature slope in 1/16 °C per second.
+ */
+void boiler_update(unsigned int temperature, int slope) {
+    if (!boiler_on || boiler_cycles < BOILER_PERIOD) {
+        return;
+    }
+    boiler_cycles = 0;
+
+    // Duty left by the pump within the combined load limit.
+    unsigned char pump = triac_pump_active();
+    int limit = LOAD_DUTY_MAX - pump;
+    if (limit > BOILER_DUTY_MAX) {
+        limit = BOILER_DUTY_MAX;
+    }
+    int feed = BOILER_FF + (((unsigned int) BREW_FF * pump) >> 8);
+
+#if BOILER_PID
+    if (slope > BOILER_SLOPE_MAX) {
+        slope = BOILER_SLOPE_MAX;
+    } else if (slope < -BOILER_SLOPE_MAX) {
+        slope = -BOILER_SLOPE_MAX;
+    }
+
+    int error = (int) boiler_setpoint - (int) temperature;
+    if (error > BOILER_ERROR_MAX) {
+        error = BOILER_ERROR_MAX;
+    } else if (error < -BOILER_ERROR_MAX) {
+        error = -BOILER_ERROR_MAX;
+    }
+
+    // KD * slope alone exceeds 16 bit (see boiler.h), so sum in 32 bit.
+    long sum = (long) BOILER_KP * error + boiler_integral - (long) BOILER_KD * slope;
+    int output = feed + (int) (sum >> BOILER_GAIN_SHIFT);
+
+    // Anti-windup: only integrate if the output is not saturated in the direction of the error.
+    if ((output < limit || error < 0) && (output > 0 || error > 0)) {
+        boiler_integral += BOILER_KI * error;
+        if (boiler_integral > BOILER_INTEGRAL_MAX) {
+            boiler_integral = BOILER_INTEGRAL_MAX;
+        } else if (boiler_integral < -BOILER_INTEGRAL_MAX) {
+            boiler_integral = -BOILER_INTEGRAL_MAX;
+        }
+    }
+
+    if (output > limit) {
+        output = limit;
+    } else if (output < 0) {
+        output = 0;
+    }
+    boiler_duty = output;
+#else
+    // Two-point control at the setpoint.
+    (void) feed;
+    (void) slope;
+    boiler_duty = (temperature < boiler_setpoint) ? limit : 0;
+#endif
+}
+
+/**
+ * Zero crossing detected. Called from the ADC interrupt.
+ */
+void boiler_zero_crossing(void) {
+    if (boiler_cycles < 255) {
+        boiler_cycles++;
+    }
+
+    boiler_phase ^= 1;
+    if (boiler_phase) {                                 // Keep state for the second half-cycle.
+        if (!is_set(TRIAC_BOILER_w, TRIAC_BOILER_pin)) {
+            boiler_halves++;
+        }
+        return;
+    }
+
+    unsigned char sigma = boiler_sigma;
+    boiler_sigma += boiler_duty;
+    unsigned char on = boiler_on && (boiler_sigma < sigma || boiler_duty == BOILER_DUTY_MAX);
+#if TRACE & TRACE_BOILER
+    if (!on == !is_set(TRIAC_BOILER_w, TRIAC_BOILER_pin)) {    // Output is active low: edge.
+        trace_put(TR_BOILER, on);
+    }
+#endif
+    if (on) {
+        clear_bit(TRIAC_BOILER_w, TRIAC_BOILER_pin);    // Boiler on for this cycle.
+        boiler_halves++;
+    } else {
+        set_bit(TRIAC_BOILER_w, TRIAC_BOILER_pin);      // Boiler off for this cycle.
+    }
+}
@@ -0,0 +1,53 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   boiler.h
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Closed loop boiler temperature control
+ */
+
+#ifndef BOILER_H
+#define BOILER_H
+
+#define BOILER_GAIN_SHIFT   4       // Fractional bits of BOILER_KP and BOILER_KI.
+#define BOILER_ERROR_MAX    254     // Error clamp (1/16 °C).
+#define BOILER_SLOPE_MAX    128     // Slope clamp (1/16 °C per second).
+#define BOILER_DUTY_MAX     255     // Full power.
+#define BOILER_INTEGRAL_MAX (BOILER_DUTY_MAX << BOILER_GAIN_SHIFT)     // Integral clamp, full power at most.
+
+// The PID sum is computed in 32 bit, each term and the shifted sum must fit 16 bit.
+#if BOILER_KP * BOILER_ERROR_MAX > 32767 || BOILER_KI * BOILER_ERROR_MAX + BOILER_INTEGRAL_MAX > 32767
+#error "BOILER_KP, BOILER_KI: proportional or integral term exceeds 16 bit"
+#endif
+#if (BOILER_KP * BOILER_ERROR_MAX + BOILER_INTEGRAL_MAX + BOILER_KD * BOILER_SLOPE_MAX) >> BOILER_GAIN_SHIFT > 32767 - 255
+#error "BOILER_KP, BOILER_KD: controller output exceeds 16 bit"
+#endif
+
+extern volatile unsigned char boiler_duty;      // Current duty cycle (0..255).
+extern volatile unsigned char boiler_halves;    // Half-cycles with boiler on (wrapping).
+
+// Prototypes:
+void boiler_enable(unsigned char on);           //  Enable or disable heating.
+void boiler_set(unsigned int setpoint);         //  Set target temperature.
+void boiler_update(unsigned int temperature, int slope);    //  Run controller (rate limited).
+void boiler_zero_crossing(void);                //  Burst modulation step.
+
+#endif
@@ -0,0 +1,153 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   buttons.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Debounced buttons
+ *
+ * All buttons are debounced together with a 2 bit vertical counter per pin:
+ * a pin changes its debounced state after 4 equal samples. Press edges are
+ * timestamped, events are derived from the hold time:
+ *   - power:      EV_POWER after BUTTON_THRESHOLD
+ *   - coffee:     EV_x_CUP on release after BUTTON_THRESHOLD,
+ *                 EV_x_CUP_LONG after BUTTON_LONG_THR
+ *   - both coffee buttons: EV_CLEAN on release after BUTTON_CLEAN_THR
+ *   - power while both coffee buttons are held: no EV_CLEAN and no EV_POWER,
+ *                 EV_DESCALE after BUTTON_DESCALE_THR
+ * A button generates no further events until it has been released.
+ */
+
+#include "hal.h"
+#include "main.h"
+#include "buttons.h"
+#include "events.h"
+#include "ticks.h"
+
+#define B_1_CUP     (1 << BUTTON_1_CUP_pin)
+#define B_2_CUP     (1 << BUTTON_2_CUP_pin)
+#define B_POWER     (1 << BUTTON_POWER_pin)
+#define B_ALL       (B_1_CUP | B_2_CUP | B_POWER)
+#define B_CLEAN     0x80                            // Clean push pending (flag in button_armed, PB7 is RESET).
+
+#if B_ALL & B_CLEAN
+#error "B_CLEAN overlaps a button pin"
+#endif
+
+// variables:
+volatile unsigned char buttons_down;                // Debounced state (1 = pushed).
+static unsigned char button_ct0 = 0xFF;             // Vertical counter, bit 0.
+static unsigned char button_ct1 = 0xFF;             // Vertical counter, bit 1.
+static unsigned char button_armed = B_ALL;          // Buttons allowed to generate events.
+static unsigned int button_since_1_cup;             // Press timestamps.
+static unsigned int button_since_2_cup;
+static unsigned int button_since_power;
+
+/**
+ * Handle a coffee button.
+ *
+ * @param bit      Button bit.
+ * @param held     Hold time (ms).
+ * @param released Released buttons in this tick.
+ * @param event    Short push event, long push is event + 1.
+ */
+static void button_cup(unsigned char bit, unsigned int held, unsigned char released, unsigned char event) {
+    if (!(button_armed & bit)) {
+        if (released & bit) {
+            button_armed |= bit;
+        }
+        return;
+    }
+    if (released & bit) {
+        if (held >= BUTTON_THRESHOLD) {
+            event_post(event);                      // Short push.
+        }
+    } else if ((buttons_down & bit) && held == BUTTON_LONG_THR) {
+        button_armed &= (unsigned char) ~bit;
+        event_post(event + 1);                      // Long push.
+    }
+}
+
+/**
+ * Sample the buttons and post events. Called from the timer interrupt every millisecond,
+ * after ticks_tick().
+ */
+void buttons_tick(void) {
+    unsigned char changed = buttons_down ^ ((unsigned char) ~BUTTONS_r & BUTTONS_MASK);
+    button_ct0 = ~(button_ct0 & changed);           // Count equal samples, reset on difference.
+    button_ct1 = button_ct0 ^ (button_ct1 & changed);
+    changed &= button_ct0 & button_ct1;             // Counter rolled over: accept change.
+    buttons_down ^= changed;
+    unsigned int now = ticks_ms;
+
+    if (!(buttons_down | changed)) {                // Nothing pushed.
+        return;
+    }
+
+    unsigned char pressed = changed & buttons_down;
+    unsigned char released = changed & (unsigned char) ~buttons_down;
+    if (pressed & B_1_CUP) {
+        button_since_1_cup = now;
+    }
+    if (pressed & B_2_CUP) {
+        button_since_2_cup = now;
+    }
+    if (pressed & B_POWER) {
+        button_since_power = now;
+    }
+
+    if (button_armed & B_POWER) {                   // Power button.
+        unsigned int held = now - button_since_power;
+        if ((buttons_down & B_ALL) == B_ALL) {      // Held together with both coffee buttons.
+            if (held == BUTTON_DESCALE_THR) {
+                button_armed &= (unsigned char) ~B_POWER;
+                event_post(EV_DESCALE);
+            }
+        } else if ((buttons_down & B_POWER) && held == BUTTON_THRESHOLD) {
+            button_armed &= (unsigned char) ~B_POWER;
+            event_post(EV_POWER);
+        }
+    } else if (released & B_POWER) {
+        button_armed |= B_POWER;
+    }
+
+    if ((button_armed & buttons_down & (B_1_CUP | B_2_CUP)) == (B_1_CUP | B_2_CUP)
+            && now - button_since_1_cup >= BUTTON_CLEAN_THR
+            && now - button_since_2_cup >= BUTTON_CLEAN_THR) {
+        button_armed = (button_armed & (unsigned char) ~(B_1_CUP | B_2_CUP)) | B_CLEAN; // Both coffee buttons pushed.
+    }
+    if (button_armed & B_CLEAN) {
+        if (buttons_down & B_POWER) {               // Power added: descaling, not rinsing.
+            button_armed &= (unsigned char) ~B_CLEAN;
+        } else if (released & (B_1_CUP | B_2_CUP)) {
+            button_armed &= (unsigned char) ~B_CLEAN;
+            event_post(EV_CLEAN);
+        }
+    }
+    button_cup(B_1_CUP, now - button_since_1_cup, released, EV_1_CUP);
+    button_cup(B_2_CUP, now - button_since_2_cup, released, EV_2_CUP);
+}
+
+/**
+ * Ignore the power button until released. Call after wake-up with the timer interrupt disabled.
+ */
+void buttons_wake(void) {
+    button_armed &= (unsigned char) ~B_POWER;
+}
@@ -0,0 +1,40 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   buttons.h
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Debounced buttons
+ */
+
+#ifndef BUTTONS_H
+#define BUTTONS_H
+
+// All buttons are on port B.
+#define BUTTONS_r           PINB
+#define BUTTONS_MASK        ((1 << BUTTON_1_CUP_pin) | (1 << BUTTON_2_CUP_pin) | (1 << BUTTON_POWER_pin))
+
+extern volatile unsigned char buttons_down;     // Debounced state (pin bits, 1 = pushed).
+
+// Prototypes:
+void buttons_tick(void);                        //  Sample buttons and post events (every 1 ms).
+void buttons_wake(void);                        //  Ignore power button until released.
+
+#endif
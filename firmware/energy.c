@@ -0,0 +1,172 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   energy.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Energy accounting (boiler and pump on-time, heat-up and brew time)
+ *
+ * The boiler and pump interrupts only count their conducting half-cycles in
+ * wrapping 8 bit counters; the main loop adds the differences to the session,
+ * heat-up and cup totals. With the boiler power and mains frequency, the
+ * half-cycles give the energy: joules = half-cycles * watts / (2 * Hz).
+ *
+ * The session totals count in steps of 16 half-cycles (whenever the 8 bit
+ * counter passes a multiple of 16), so 16 bit saturate only after 2.9 hours
+ * of full boiler power or continuous pumping at 50 Hz.
+ *
+ * With TRACE_ENERGY the totals are sent as trace records when the machine
+ * gets ready, after each brew and at power-off, scaled to 12 bit.
+ */
+
+#include "hal.h"
+#include "main.h"
+#include "boiler.h"
+#include "energy.h"
+#include "ticks.h"
+#include "trace.h"
+#include "triac.h"
+
+#define ENERGY_HEATING      0       // Timing and counting wake-up to ready.
+#define ENERGY_BREWING      1       // Timing and counting a brew.
+#define ENERGY_AWAKE        2       // Session running.
+
+// variables:
+energy_t energy;                                // Counters.
+static unsigned char energy_halves;             // Boiler half-cycles accounted for.
+static unsigned char energy_strokes;            // Pump strokes accounted for.
+static unsigned char energy_quarter;            // Quarter second accounted for.
+static unsigned char energy_timing;             // Session and running timers (ENERGY_* bits).
+static unsigned char energy_coffee;             // Coffee mode being brewed.
+
+#if TRACE & TRACE_ENERGY
+/**
+ * Scale a counter to a 12 bit record value.
+ *
+ * @param value Counter.
+ * @param shift Divide by 2^shift.
+ * @return Scaled value, saturated at 0x0FFF.
+ */
+static unsigned int energy_scale(unsigned long value, unsigned char shift) {
+    value >>= shift;
+    return (value > 0x0FFF) ? 0x0FFF : value;
+}
+#endif
+
+/**
+ * Add the steps of 16 a wrapping 8 bit counter passed to a saturating total.
+ *
+ * @param total Total (16 counts).
+ * @param last  Counter value accounted for.
+ * @param count Counts since then.
+ */
+static void energy_add16(unsigned int *total, unsigned char last, unsigned char count) {
+    unsigned char steps = (((unsigned int) last + count) >> 4) - (last >> 4);
+    *total = (*total > 65535U - steps) ? 65535 : *total + steps;
+}
+
+/**
+ * Start a new session. Called after wake-up.
+ */
+void energy_wake(void) {
+    energy.session_boiler = 0;
+    energy.session_pump = 0;
+    energy.heat_boiler = 0;
+    energy.ready = 0;
+    energy_halves = boiler_halves;
+    energy_strokes = triac_strokes;
+    energy_quarter = ticks_quarter;
+    energy_timing = (1 << ENERGY_AWAKE) | (1 << ENERGY_HEATING);
+}
+
+/**
+ * Add the half-cycles since the last call and advance the timers.
+ */
+void energy_update(void) {
+    unsigned char halves = boiler_halves - energy_halves;
+    unsigned char strokes = triac_strokes - energy_strokes;
+    unsigned char quarters = ticks_quarter - energy_quarter;
+    energy_add16(&energy.session_boiler, energy_halves, halves);
+    energy_add16(&energy.session_pump, energy_strokes, strokes);
+    energy_halves += halves;
+    energy_strokes += strokes;
+    energy_quarter += quarters;
+
+    if (is_set(energy_timing, ENERGY_HEATING)) {
+        energy.ready += quarters;
+        energy.heat_boiler = (energy.heat_boiler > 65535U - halves) ? 65535 : energy.heat_boiler + halves;
+    }
+    if (is_set(energy_timing, ENERGY_BREWING)) {
+        energy.cup_boiler += halves;
+        energy.cup_pump += strokes;
+        unsigned char *brew = &energy.brew[energy_coffee - 1];
+        *brew = (*brew > 255 - quarters) ? 255 : *brew + quarters;
+    }
+}
+
+/**
+ * Operating temperature reached. Stops the heat-up timer on the first call after wake-up.
+ */
+void energy_ready(void) {
+    if (is_set(energy_timing, ENERGY_HEATING)) {
+        energy_update();
+        clear_bit(energy_timing, ENERGY_HEATING);
+        trace(TRACE_ENERGY, TR_READY, energy_scale(energy.ready, 0));
+        trace(TRACE_ENERGY, TR_HEAT_BOILER, energy_scale(energy.heat_boiler, 4));
+    }
+}
+
+/**
+ * Start counting a brew.
+ *
+ * @param coffee Coffee mode (ONE_ESPRESSO .. TWO_COFFEE).
+ */
+void energy_brew_start(unsigned char coffee) {
+    energy_update();
+    energy.cup_boiler = 0;
+    energy.cup_pump = 0;
+    energy.brew[coffee - 1] = 0;
+    energy_coffee = coffee;
+    set_bit(energy_timing, ENERGY_BREWING);
+}
+
+/**
+ * Brew finished (or aborted).
+ */
+void energy_brew_end(void) {
+    energy_update();
+    clear_bit(energy_timing, ENERGY_BREWING);
+    trace(TRACE_ENERGY, TR_BREW, (energy_coffee << 8) | energy.brew[energy_coffee - 1]);
+    trace(TRACE_ENERGY, TR_CUP_BOILER, energy_scale(energy.cup_boiler, 1));
+    trace(TRACE_ENERGY, TR_CUP_PUMP, energy_scale(energy.cup_pump, 1));
+}
+
+/**
+ * Session ends. Called on power-off.
+ */
+void energy_off(void) {
+    if (!is_set(energy_timing, ENERGY_AWAKE)) {     // Power-up.
+        return;
+    }
+    energy_update();
+    energy_timing = 0;
+    trace(TRACE_ENERGY, TR_SESSION_BOILER, energy_scale(energy.session_boiler, 4));
+    trace(TRACE_ENERGY, TR_SESSION_PUMP, energy_scale(energy.session_pump, 4));
+}
@@ -0,0 +1,53 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   energy.h
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Energy accounting (boiler and pump on-time, heat-up and brew time)
+ */
+
+#ifndef ENERGY_H
+#define ENERGY_H
+
+/**
+ * Counters since the last wake-up. Read them from the main loop.
+ */
+typedef struct {
+    unsigned int session_boiler;    // Boiler on since wake-up (16 mains half-cycles, up to 65535).
+    unsigned int session_pump;      // Pump fired since wake-up (16 mains half-cycles, up to 65535).
+    unsigned int heat_boiler;       // Boiler on from wake-up to ready (mains half-cycles, up to 65535).
+    unsigned int cup_boiler;        // Boiler on during the last brew (mains half-cycles).
+    unsigned int cup_pump;          // Pump fired during the last brew (mains half-cycles).
+    unsigned int ready;             // Wake-up to ready (quarter seconds, 0 until ready).
+    unsigned char brew[4];          // Last brew duration per coffee mode (quarter seconds, up to 255).
+} energy_t;
+
+extern energy_t energy;
+
+// Prototypes:
+void energy_wake(void);                         //  Start a new session.
+void energy_update(void);                       //  Accumulate counters (main loop).
+void energy_ready(void);                        //  Operating temperature reached.
+void energy_brew_start(unsigned char coffee);   //  Start counting a brew.
+void energy_brew_end(void);                     //  Brew finished.
+void energy_off(void);                          //  Session ends.
+
+#endif
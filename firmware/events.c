@@ -0,0 +1,106 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   events.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Event queue between interrupts and main loop
+ *
+ * Single producer, single consumer ring buffer: only interrupt handlers
+ * (which do not nest) write the head and only the main loop writes the tail.
+ * Both indices are single bytes, so neither side needs to disable
+ * interrupts. Events posted to a full queue are dropped and counted.
+ *
+ * An EV_TIMER can still be queued when the main loop restarts the timer,
+ * e.g. when EV_DOSED ends a segment in the same pass. event_timer_start()
+ * marks it stale and event_get() skips it, so it cannot end the next
+ * segment as well.
+ */
+
+#include "hal.h"
+#include "events.h"
+
+// variables:
+static volatile unsigned char event_queue[EVENT_QUEUE_SIZE];   // Queued events.
+static volatile unsigned char event_head;                       // Next write (producer).
+static volatile unsigned char event_tail;                       // Next read (consumer).
+static volatile unsigned char event_timer;                      // Event timer (half seconds).
+static volatile unsigned char event_timer_due;                  // Queued EV_TIMER belongs to the running timer.
+volatile unsigned char event_lost;                              // Dropped events.
+
+/**
+ * Queue an event. Called from interrupt handlers only.
+ *
+ * @param event Event code.
+ */
+void event_post(unsigned char event) {
+    unsigned char head = event_head;
+    unsigned char next = (head + 1) & (EVENT_QUEUE_SIZE - 1);
+    if (next != event_tail) {
+        event_queue[head] = event;
+        event_head = next;
+    } else if (event_lost < 255) {
+        event_lost++;
+    }
+}
+
+/**
+ * Dequeue the oldest event. Called from the main loop only.
+ *
+ * @return Event code, EV_NONE if the queue is empty.
+ */
+unsigned char event_get(void) {
+    unsigned char event;
+    do {
+        unsigned char tail = event_tail;
+        if (tail == event_head) {
+            return EV_NONE;
+        }
+        event = event_queue[tail];
+        event_tail = (tail + 1) & (EVENT_QUEUE_SIZE - 1);
+    } while (event == EV_TIMER && !event_timer_due);   // Skip the timeout of a restarted timer.
+    return event;
+}
+
+/**
+ * Start the event timer. EV_TIMER is posted once it expires, after at least
+ * the given time (the timer runs in steps of the half second clock).
+ *
+ * @param halves Timeout in half seconds (up to 127s, longer is cut to 127s), 0 to stop the timer.
+ */
+void event_timer_start(unsigned char halves) {
+    if (halves > EVENT_TIMER_MAX) {
+        halves = EVENT_TIMER_MAX;                   // The counter runs one step longer and must not wrap.
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        event_timer = halves ? halves + 1 : 0;
+        event_timer_due = 0;                        // A queued EV_TIMER is stale now.
+    }
+}
+
+/**
+ * Advance the event timer. Called from the timer interrupt every half second.
+ */
+void event_tick(void) {
+    if (event_timer > 0 && --event_timer == 0) {
+        event_timer_due = 1;
+        event_post(EV_TIMER);
+    }
+}
@@ -0,0 +1,62 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   events.h
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Event queue between interrupts and main loop
+ */
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+// Queue length (power of two, holds one event less). Between two passes of the main loop (up to
+// 4 ms) the buttons post at most three events, one per button, and the timer interrupt one EV_TIMER and
+// one AutoOff EV_POWER; the ADC interrupt adds one EV_DOSED. 8 leaves one slot of margin.
+#define EVENT_QUEUE_SIZE    8
+#define EVENT_TIMER_MAX     254     // Longest event timer (half seconds).
+
+// Events.
+#define EV_NONE             0       // Queue empty.
+#define EV_ANY              0       // Wildcard in transition tables.
+#define EV_POWER            1       // Power button pushed or AutoOff expired.
+#define EV_1_CUP            2       // Left button pushed shortly (on release).
+#define EV_1_CUP_LONG       3       // Left button held (BUTTON_LONG_THR).
+#define EV_2_CUP            4       // Right button pushed shortly (on release).
+#define EV_2_CUP_LONG       5       // Right button held (BUTTON_LONG_THR).
+#define EV_CLEAN            6       // Both coffee buttons pushed (on release).
+#define EV_TIMER            7       // Event timer expired.
+#define EV_WATER_LOW        8       // Sensors: water too low.
+#define EV_TEMP_LOW         9       // Sensors: water OK, temperature too low.
+#define EV_TEMP_OK          10      // Sensors: water and temperature OK.
+#define EV_DOSED            11      // Pump dose delivered.
+#define EV_TEMP_BAND        12      // Sensors: water OK, temperature within brew band.
+#define EV_FAULT            13      // Supervisor: fault detected.
+#define EV_DESCALE          14      // All three buttons held (BUTTON_DESCALE_THR).
+
+extern volatile unsigned char event_lost;   // Events dropped on a full queue (saturating).
+
+// Prototypes:
+void event_post(unsigned char event);       //  Queue event (interrupts only).
+unsigned char event_get(void);              //  Dequeue event (main loop only).
+void event_timer_start(unsigned char halves);       //  Start event timer (up to 254, 0 to stop).
+void event_tick(void);                      //  Advance event timer by 1/2 s (timer interrupt).
+
+#endif
@@ -0,0 +1,60 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   hal.h
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Hardware abstraction layer
+ *
+ * All firmware modules include this header instead of the AVR headers.
+ * On the target it maps to avr-libc, on the host (make host) registers,
+ * interrupts and sleep are provided by the plant simulator.
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+#ifdef __AVR__
+
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <avr/wdt.h>
+#include <util/atomic.h>
+
+#ifdef BENCH
+#define hal_yield()     (PORTB ^= (1 << 2))         // Main loop marker on PB2 (SCK) for make bench.
+#define hal_probe(on)   ((on) ? (PORTB |= (1 << 0)) : (PORTB &= (unsigned char) ~(1 << 0)))    // Cost marker on PB0 (MOSI).
+#else
+#define hal_yield()     do {} while (0)             // Main loop pass (simulator hook).
+#define hal_probe(on)   do {} while (0)             // Cost marker (make bench).
+#endif
+#define hal_sleep()     asm volatile("sleep"::)     // Enter sleep mode set in MCUCR.
+#define hal_state(state)    do {} while (0)         // State machine transition (simulator hook).
+#define hal_eeprom_read(address)    eeprom_read_byte((const uint8_t *) (unsigned int) (address))
+
+#else
+
+#include "host/hal_host.h"
+
+#endif
+
+#endif
@@ -0,0 +1,424 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   fuzz.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Randomized input fuzzer with safety invariants
+ *
+ * A fuzz input is a script of FUZZ_STEP byte steps (operation, 16 bit
+ * argument): wait, push buttons, set the tank level or the boiler
+ * temperature. The firmware runs the script on the simulated machine,
+ * followed by an idle tail until Auto-Off. After every simulated event the
+ * invariants are checked:
+ *   - no pump gate while the tank is below the hall switch,
+ *   - no boiler gate while rinsing,
+ *   - no pump or boiler gate in the fault state,
+ *   - switched off AUTO_OFF_THRESHOLD after the last push or pump stroke,
+ *   - no event dropped by a full event queue.
+ *
+ * Firmware, simulator and plant are reset between inputs by restoring their
+ * data and bss, which the Makefile collects into the fw_data and fw_bss
+ * (firmware) and fuzz_data and fuzz_bss (simulator, plant) sections. So inputs run in-process, with the standalone driver below or
+ * as libFuzzer target (FUZZ_LIBFUZZER, LLVMFuzzerTestOneInput).
+ *
+ * Usage: SenseoControl-2.0-fuzz [-n RUNS] [-s SEED] [-j JOBS] [-o DIR] [FILE...]
+ *
+ * Without files, RUNS random inputs are generated from SEED in JOBS
+ * processes. Failing inputs are minimized and written to DIR as
+ * replayable regression cases. With files, each one is replayed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "../hal.h"
+#include "../main.h"
+#include "../events.h"
+#include "plant.h"
+#include "sim.h"
+
+#define FUZZ_STEP           3       // Bytes per script step (operation, 16 bit argument).
+#define FUZZ_STEPS          64      // Maximum script steps of generated inputs.
+#define FUZZ_TAIL_MS        ((AUTO_OFF_THRESHOLD + 10) * 1000UL)    // Idle run after the script.
+#define FUZZ_SLICE_MS       100     // Run granularity while waiting for a violation.
+#define FUZZ_WATER_LOW_ML   60.0    // Hall switch fully open below this level (plant model).
+#define FUZZ_WATER_GRACE_MS 20      // Pump gate allowed after the tank ran low (detection, gate in progress).
+#define FUZZ_AUTO_OFF_SLACK 2       // Seconds allowed beyond AUTO_OFF_THRESHOLD.
+
+// Script operations (first byte of a step, modulo FUZZ_OPS).
+#define OP_WAIT             0       // Run for argument ms.
+#define OP_PUSH             1       // Push buttons (bits 0..2: power, 1 cup, 2 cup), hold for argument >> 3 ms.
+#define OP_TANK             2       // Set tank to argument ml (modulo full tank, 0: lifted off).
+#define OP_HEAT             3       // Set boiler to ambient + argument °C (modulo 100).
+#define FUZZ_OPS            4
+
+// Invariant violations.
+#define V_NONE              0
+#define V_PUMP_DRY          1
+#define V_BOILER_RINSING    2
+#define V_AUTO_OFF          3
+#define V_FAULT_OUTPUT      4
+#define V_EVENT_LOST        5
+
+static const char *violations[] = {"none", "pump while water low", "boiler while rinsing", "no auto-off",
+        "outputs on in fault state", "event queue overflow"};
+
+extern char __start_fuzz_data[], __stop_fuzz_data[], __start_fuzz_bss[], __stop_fuzz_bss[];
+extern char __start_fw_data[], __stop_fw_data[], __start_fw_bss[], __stop_fw_bss[];
+
+static char *fuzz_snapshot;         // Initial contents of fuzz_data and fw_data.
+static unsigned char violation;     // First violation of the current run.
+static sim_time_t violation_time;   // Time of the first violation.
+static sim_time_t dry_since;        // Tank below FUZZ_WATER_LOW_ML since (0: not low).
+static sim_time_t active_until;     // Last push or pump stroke.
+static unsigned long long fuzz_ms;  // Simulated milliseconds of all runs.
+
+/**
+ * Invariant check after every simulated event.
+ */
+static void fuzz_monitor(void) {
+    unsigned char pump = !(PORTA & (1 << TRIAC_PUMP_pin));
+    unsigned char boiler = !(PORTA & (1 << TRIAC_BOILER_pin));
+    unsigned char found = V_NONE;
+
+    if (plant.tank_ml >= FUZZ_WATER_LOW_ML) {
+        dry_since = 0;
+    } else if (!dry_since) {
+        dry_since = sim_now;
+    }
+    if (pump) {
+        if (dry_since && sim_now - dry_since > FUZZ_WATER_GRACE_MS * SIM_CYCLES_PER_MS) {
+            found = V_PUMP_DRY;
+        }
+        active_until = sim_now;
+    }
+    if (boiler && sim_state == M_RINSING) {
+        found = V_BOILER_RINSING;
+    }
+    if ((pump || boiler) && sim_state == M_FAULT) {
+        found = V_FAULT_OUTPUT;
+    }
+    if (sim_state != M_OFF
+            && sim_now > active_until + (AUTO_OFF_THRESHOLD + FUZZ_AUTO_OFF_SLACK) * (sim_time_t) F_CPU) {
+        found = V_AUTO_OFF;
+    }
+    if (event_lost) {
+        found = V_EVENT_LOST;
+    }
+    if (found && !violation) {
+        violation = found;
+        violation_time = sim_now;
+    }
+}
+
+/**
+ * Reset firmware, simulator and plant to their initial state.
+ */
+static void fuzz_reset(void) {
+    size_t size = __stop_fuzz_data - __start_fuzz_data;
+    size_t fw = __stop_fw_data - __start_fw_data;
+    if (!fuzz_snapshot) {
+        fuzz_snapshot = malloc(size + fw);
+        memcpy(fuzz_snapshot, __start_fuzz_data, size);
+        memcpy(fuzz_snapshot + size, __start_fw_data, fw);
+    }
+    memcpy(__start_fuzz_data, fuzz_snapshot, size);
+    memset(__start_fuzz_bss, 0, __stop_fuzz_bss - __start_fuzz_bss);
+    memcpy(__start_fw_data, fuzz_snapshot + size, fw);              // Initial state for sim_start().
+    memset(__start_fw_bss, 0, __stop_fw_bss - __start_fw_bss);
+    violation = V_NONE;
+    dry_since = 0;
+    active_until = 0;
+    sim_start();
+    sim_monitor = fuzz_monitor;
+}
+
+/**
+ * Run until the given time has passed or an invariant is violated.
+ *
+ * @param ms Duration.
+ */
+static void fuzz_wait(unsigned long ms) {
+    while (ms && !violation) {
+        unsigned long slice = ms < FUZZ_SLICE_MS ? ms : FUZZ_SLICE_MS;
+        sim_run(slice);
+        fuzz_ms += slice;
+        ms -= slice;
+    }
+}
+
+/**
+ * Run one input on a freshly reset machine.
+ *
+ * @param data Script.
+ * @param size Script length (bytes, incomplete steps are ignored).
+ * @return Violation (V_*).
+ */
+static unsigned char fuzz_run(const unsigned char *data, size_t size) {
+    static const unsigned char pins[] = {BUTTON_POWER_pin, BUTTON_1_CUP_pin, BUTTON_2_CUP_pin};
+    fuzz_reset();
+    fuzz_wait(1000);                                        // Boot.
+    for (size_t i = 0; i + FUZZ_STEP <= size && !violation; i += FUZZ_STEP) {
+        unsigned int arg = data[i + 1] | data[i + 2] << 8;
+        switch (data[i] % FUZZ_OPS) {
+            case OP_WAIT:
+                fuzz_wait(arg);
+                break;
+            case OP_PUSH:
+                for (unsigned char b = 0; b < 3; b++) {
+                    if (arg & (1 << b)) {
+                        sim_press(pins[b], 0, arg >> 3);
+                    }
+                }
+                active_until = sim_now + (sim_time_t) (arg >> 3) * SIM_CYCLES_PER_MS;
+                fuzz_wait(arg >> 3);
+                break;
+            case OP_TANK:
+                plant.tank_ml = arg % (unsigned int) (PLANT_TANK_ML + 1);
+                break;
+            case OP_HEAT:
+                plant.t_block = plant.t_water = plant.t_sensor = plant.ambient + arg % 100;
+                break;
+        }
+    }
+    for (unsigned long ms = 0; ms < FUZZ_TAIL_MS && !violation && sim_state != M_OFF; ms += 1000) {
+        fuzz_wait(1000);                                    // Idle until Auto-Off.
+    }
+    return violation;
+}
+
+#ifdef FUZZ_LIBFUZZER
+
+/**
+ * libFuzzer entry point: abort on a violation, libFuzzer keeps the input.
+ */
+int LLVMFuzzerTestOneInput(const unsigned char *data, size_t size) {
+    unsigned char found = fuzz_run(data, size);
+    if (found) {
+        fprintf(stderr, "fuzz: %s at %.3f s\n", violations[found], (double) violation_time / F_CPU);
+        abort();
+    }
+    return 0;
+}
+
+#else
+
+/**
+ * Next pseudo random number (xorshift, independent of the plant's rand()).
+ */
+static unsigned long fuzz_random(unsigned long *state) {
+    unsigned long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+/**
+ * Generate a random script, biased towards short waits and pushes around the button thresholds.
+ *
+ * @return Script length (bytes).
+ */
+static size_t fuzz_generate(unsigned char *data, unsigned long *seed) {
+    size_t steps = 1 + fuzz_random(seed) % FUZZ_STEPS;
+    for (size_t i = 0; i < steps; i++) {
+        unsigned char op = fuzz_random(seed) % 20;
+        unsigned int arg;
+        if (op < 8) {
+            op = OP_WAIT;
+            arg = (fuzz_random(seed) % 8) ? fuzz_random(seed) % 5000 : fuzz_random(seed) % 65536;
+        } else if (op < 15) {
+            op = OP_PUSH;
+            arg = (1 + fuzz_random(seed) % 7) | (fuzz_random(seed) % 3000) << 3;
+        } else if (op < 18) {
+            op = OP_TANK;
+            arg = (fuzz_random(seed) % 4) ? fuzz_random(seed) % 120 : fuzz_random(seed) % 751;
+        } else {
+            op = OP_HEAT;
+            arg = fuzz_random(seed) % 100;
+        }
+        data[i * FUZZ_STEP] = op;
+        data[i * FUZZ_STEP + 1] = arg & 0xFF;
+        data[i * FUZZ_STEP + 2] = arg >> 8;
+    }
+    return steps * FUZZ_STEP;
+}
+
+/**
+ * Shrink a failing script while it keeps failing with the same violation:
+ * drop chunks of steps (halving the chunk size), then halve arguments.
+ *
+ * @return Minimized length (bytes).
+ */
+static size_t fuzz_minimize(unsigned char *data, size_t size, unsigned char found) {
+    unsigned char trial[FUZZ_STEPS * FUZZ_STEP];
+    size_t steps = size / FUZZ_STEP;
+    for (size_t chunk = steps / 2 ? steps / 2 : 1; chunk; chunk /= 2) {
+        for (size_t start = 0; start + chunk <= steps;) {
+            memcpy(trial, data, start * FUZZ_STEP);
+            memcpy(trial + start * FUZZ_STEP, data + (start + chunk) * FUZZ_STEP, (steps - start - chunk) * FUZZ_STEP);
+            if (fuzz_run(trial, (steps - chunk) * FUZZ_STEP) == found) {
+                memcpy(data, trial, (steps - chunk) * FUZZ_STEP);
+                steps -= chunk;
+            } else {
+                start += chunk;
+            }
+        }
+    }
+    for (size_t i = 0; i < steps; i++) {
+        unsigned char *step = data + i * FUZZ_STEP;
+        unsigned int shift = (step[0] % FUZZ_OPS == OP_PUSH) ? 3 : 0;   // Keep the buttons of a push.
+        unsigned int arg = step[1] | step[2] << 8;
+        while (arg >> shift) {
+            unsigned int half = ((arg >> shift) / 2) << shift | (arg & ((1 << shift) - 1));
+            memcpy(trial, data, steps * FUZZ_STEP);
+            trial[i * FUZZ_STEP + 1] = half & 0xFF;
+            trial[i * FUZZ_STEP + 2] = half >> 8;
+            if (fuzz_run(trial, steps * FUZZ_STEP) != found) {
+                break;
+            }
+            step[1] = half & 0xFF;
+            step[2] = half >> 8;
+            arg = half;
+        }
+    }
+    return steps * FUZZ_STEP;
+}
+
+/**
+ * Print a script in readable form.
+ */
+static void fuzz_print(const unsigned char *data, size_t size) {
+    static const char *ops[] = {"wait", "push", "tank", "heat"};
+    for (size_t i = 0; i + FUZZ_STEP <= size; i += FUZZ_STEP) {
+        unsigned int arg = data[i + 1] | data[i + 2] << 8;
+        unsigned char op = data[i] % FUZZ_OPS;
+        if (op == OP_PUSH) {
+            printf("  push %s%s%s%u ms\n", (arg & 1) ? "power " : "", (arg & 2) ? "1cup " : "",
+                   (arg & 4) ? "2cup " : "", arg >> 3);
+        } else {
+            printf("  %s %u\n", ops[op], arg);
+        }
+    }
+}
+
+/**
+ * Replay regression cases.
+ *
+ * @return Number of failing files.
+ */
+static int fuzz_replay(int count, char **files) {
+    int failed = 0;
+    for (int f = 0; f < count; f++) {
+        unsigned char data[4096];
+        FILE *file = fopen(files[f], "rb");
+        size_t size = file ? fread(data, 1, sizeof(data), file) : 0;
+        if (file) {
+            fclose(file);
+        }
+        unsigned char found = file ? fuzz_run(data, size) : V_NONE;
+        printf("replay.%s=%s\n", files[f], !file ? "unreadable" : violations[found]);
+        failed += !file || found;
+    }
+    return failed;
+}
+
+/**
+ * Generate and run random inputs, minimize and save failures.
+ *
+ * @return Number of failing inputs.
+ */
+static int fuzz_random_runs(unsigned long runs, unsigned long seed, const char *dir) {
+    int failed = 0;
+    clock_t start = clock();
+    for (unsigned long run = 0; run < runs; run++) {
+        unsigned char data[FUZZ_STEPS * FUZZ_STEP];
+        unsigned long state = seed * 2654435761UL + run + 1;
+        size_t size = fuzz_generate(data, &state);
+        unsigned char found = fuzz_run(data, size);
+        if (!found) {
+            continue;
+        }
+        failed++;
+        size = fuzz_minimize(data, size, found);
+        fuzz_run(data, size);
+        char path[256];
+        snprintf(path, sizeof(path), "%s/fuzz-%lu-%lu.bin", dir, seed, run);
+        FILE *file = fopen(path, "wb");
+        if (file) {
+            fwrite(data, 1, size, file);
+            fclose(file);
+        }
+        printf("fuzz.FAIL=%s at %.3f s (seed %lu, run %lu), saved to %s:\n", violations[found],
+               (double) violation_time / F_CPU, seed, run, file ? path : "(not written)");
+        fuzz_print(data, size);
+    }
+    double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+    printf("fuzz.seed%lu.runs=%lu\n", seed, runs);
+    printf("fuzz.seed%lu.simulated_s=%.0f\n", seed, fuzz_ms / 1000.0);
+    printf("fuzz.seed%lu.ticks_per_s=%.0f\n", seed, seconds > 0 ? fuzz_ms / seconds : 0);
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    unsigned long runs = 200, seed = 1, jobs = 1;
+    const char *dir = ".";
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:j:o:")) != -1) {
+        if (opt == 'n') {
+            runs = strtoul(optarg, NULL, 0);
+        } else if (opt == 's') {
+            seed = strtoul(optarg, NULL, 0);
+        } else if (opt == 'j') {
+            jobs = strtoul(optarg, NULL, 0);
+        } else if (opt == 'o') {
+            dir = optarg;
+        } else {
+            printf("Usage: %s [-n RUNS] [-s SEED] [-j JOBS] [-o DIR] [FILE...]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind < argc) {
+        return fuzz_replay(argc - optind, argv + optind) ? 1 : 0;
+    }
+
+    int failed = 0;
+    jobs = jobs ? jobs : 1;
+    fflush(stdout);
+    for (unsigned long job = 0; job < jobs; job++) {            // One seed per job.
+        if (fork() == 0) {
+            int result = fuzz_random_runs(runs / jobs + (job < runs % jobs), seed + job, dir);
+            fflush(stdout);
+            _exit(result > 100 ? 100 : result);
+        }
+    }
+    for (unsigned long job = 0; job < jobs; job++) {
+        int status;
+        wait(&status);
+        failed += !WIFEXITED(status) || WEXITSTATUS(status);
+    }
+    return failed ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,144 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   hal_host.h
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Simulated ATtiny861A registers for the host build
+ */
+
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+
+// I/O registers (ATtiny861A subset used by the firmware).
+extern volatile unsigned char PORTA, PINA, DDRA, PORTB, PINB, DDRB;
+extern volatile unsigned char ADCSRA, ADMUX, ADCL, ADCH;
+extern volatile unsigned char TCCR0B, TCNT0L, OCR0A, TCCR1A, TCCR1B, TCNT1, OCR1A, OCR1B, OCR1C;
+extern volatile unsigned char TIMSK, TIFR, GIMSK, MCUCR, MCUSR, SREG;
+extern volatile unsigned char EEAR, EEDR, EECR;
+extern unsigned char sim_eeprom[];                  // EEPROM contents.
+extern unsigned char sim_state;                     // Current state machine state.
+
+// ADCSRA
+#define ADEN    7
+#define ADSC    6
+#define ADATE   5
+#define ADIF    4
+#define ADIE    3
+#define ADPS2   2
+#define ADPS1   1
+#define ADPS0   0
+// ADMUX
+#define REFS1   7
+#define REFS0   6
+#define ADLAR   5
+// TCCR1A
+#define COM1A1  7
+#define COM1A0  6
+#define COM1B1  5
+#define COM1B0  4
+#define FOC1A   3
+#define FOC1B   2
+#define PWM1A   1
+#define PWM1B   0
+// TCCR1B
+#define PSR1    6
+#define CS13    3
+#define CS12    2
+#define CS11    1
+#define CS10    0
+// TCCR0B
+#define PSR0    3
+#define CS02    2
+#define CS01    1
+#define CS00    0
+// TIMSK, TIFR
+#define OCIE1A  6
+#define OCIE1B  5
+#define OCIE0A  4
+#define TOIE1   2
+#define TOIE0   1
+#define OCF1A   6
+#define OCF1B   5
+#define OCF0A   4
+#define TOV1    2
+#define TOV0    1
+// GIMSK
+#define INT0    6
+// MCUCR
+#define SE      5
+#define SM1     4
+#define SM0     3
+// EECR
+#define EERIE   3
+#define EEMPE   2
+#define EEPE    1
+#define EERE    0
+// MCUSR
+#define WDRF    3
+#define BORF    2
+#define EXTRF   1
+#define PORF    0
+
+// Watchdog timeouts (2K to 256K cycles of the 128 kHz watchdog oscillator).
+#define WDTO_15MS   0
+#define WDTO_30MS   1
+#define WDTO_60MS   2
+#define WDTO_120MS  3
+#define WDTO_250MS  4
+#define WDTO_500MS  5
+#define WDTO_1S     6
+#define WDTO_2S     7
+
+#define _BV(bit)                            (1 << (bit))
+#define bit_is_set(sfr, bit)                ((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit)              (!((sfr) & _BV(bit)))
+#define loop_until_bit_is_clear(sfr, bit)   do { sim_yield(); } while (bit_is_set(sfr, bit))
+
+// Interrupts are delivered by the simulator between main loop passes.
+#define ISR(vector)     void vector(void); void vector(void)
+#define sei()           (SREG |= 0x80)
+#define cli()           (SREG &= 0x7F)
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_BLOCK(type) \
+    for (unsigned char hal_sreg = SREG, hal_once = (cli(), 1); hal_once; SREG = hal_sreg, hal_once = 0)
+
+// Program memory is ordinary memory on the host.
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const unsigned char *) (addr))
+#define pgm_read_word(addr) (*(const unsigned int *) (addr))
+
+#define hal_yield()     sim_yield()
+#define hal_sleep()     sim_sleep()
+#define hal_eeprom_read(address)    (sim_eeprom[(address)])
+#define hal_state(state)    (sim_state = (state))
+#define hal_probe(on)   do {} while (0)
+
+#define wdt_enable(timeout) sim_watchdog(timeout)
+#define wdt_disable()       sim_watchdog(0xFF)
+#define wdt_reset()         sim_wdr()
+
+void sim_yield(void);
+void sim_sleep(void);
+void sim_watchdog(unsigned char timeout);
+void sim_wdr(void);
+
+#endif
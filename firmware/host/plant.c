@@ -0,0 +1,269 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   plant.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Simulated coffee machine (mains, boiler, pump, tank, LEDs)
+ *
+ * The boiler is modelled with two thermal masses (heating element/block and
+ * water) and a first order NTC lag. Triac outputs are evaluated per mains
+ * half-cycle: a triac conducts from the first moment its gate is seen until
+ * the end of the half-cycle. The pump moves stroke_ml per half-cycle if it
+ * conducted for more than half of the energy of that half-cycle.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "../hal.h"
+#include "../main.h"
+#include "plant.h"
+
+#define PLANT_C_BLOCK       500.0   // Heat capacity of element and block (J/K).
+#define PLANT_C_WATER       400.0   // Heat capacity of boiler water (J/K).
+#define PLANT_K_TRANSFER    80.0    // Block to water conductance (W/K).
+#define PLANT_K_LOSS        1.0     // Block to ambient conductance (W/K).
+#define PLANT_TAU_SENSOR    3.0     // NTC time constant (s).
+#define PLANT_C_ML          4.186   // Heat capacity of water (J/(K*ml)).
+
+#define PLANT_NTC_R25       10000.0 // NTC resistance at 25 °C.
+#define PLANT_NTC_BETA      3950.0  // NTC beta value.
+#define PLANT_NTC_RS        1000.0  // Series resistor to GND (R12).
+
+#define PLANT_MAINS_PEAK    9.5     // Rectified transformer peak voltage.
+#define PLANT_ADC_NOISE     8       // Peak ADC noise (counts).
+
+#define PLANT_LEDS  ((1 << LED_RED_pin) | (1 << LED_GREEN_pin) | (1 << LED_BLUE_pin))
+
+// variables:
+struct plant plant;
+static sim_time_t plant_time;           // Time of last observation.
+static unsigned long plant_half;        // Index of current half-cycle.
+static double plant_pump;               // Pump conduction (energy fraction) in current half-cycle.
+static double plant_boiler;             // Boiler conduction (energy fraction) in current half-cycle.
+static unsigned char plant_boiler_gate; // Boiler gate at last observation.
+static unsigned char plant_pump_gate;   // Pump gate at last observation.
+static unsigned char serial_level;      // Trace line level since last call.
+static double serial_start;             // Start of current frame (cycles, 0 if idle).
+static unsigned char serial_bit;        // Next bit to sample in the frame.
+static unsigned int serial_frame;       // Bits sampled so far.
+
+/**
+ * Reset to a cold machine with a full tank.
+ */
+void plant_init(void) {
+    plant.mains_hz = 50.0;
+    plant.ambient = 20.0;
+    plant.boiler_watts = 1450.0;
+    plant.stroke_ml = 0.05;
+    plant.ntc = PLANT_NTC_OK;
+    plant.t_block = plant.ambient;
+    plant.t_water = plant.ambient;
+    plant.t_sensor = plant.ambient;
+    plant.tank_ml = PLANT_TANK_ML;
+    srand(1);
+}
+
+/**
+ * Energy fraction of a half-cycle conducted from the given position to its end.
+ *
+ * @param position Position within half-cycle (0..1).
+ * @return Fraction of the half-cycle energy.
+ */
+static double plant_conduction(double position) {
+    double phi = M_PI * position;
+    return (M_PI - phi + sin(2 * phi) / 2) / M_PI;
+}
+
+/**
+ * Apply one finished half-cycle to the physical model.
+ */
+static void plant_finish_half(void) {
+    double dt = 0.5 / plant.mains_hz;
+    double heat = plant.boiler_watts * plant_boiler * dt;
+    if (plant_boiler > 0) {
+        plant.boiler_halves++;
+    }
+    plant.boiler_joules += heat;
+
+    double transfer = PLANT_K_TRANSFER * (plant.t_block - plant.t_water) * dt;
+    plant.t_block += (heat * (1 - plant.scale) - transfer - PLANT_K_LOSS * (plant.t_block - plant.ambient) * dt) / PLANT_C_BLOCK;
+    plant.t_water += transfer / PLANT_C_WATER;
+
+    if (plant_pump > 0.5 && plant.tank_ml >= plant.stroke_ml) {     // Fresh water replaces brewed water.
+        plant.strokes++;
+        plant.tank_ml -= plant.stroke_ml;
+        plant.cup_ml += plant.stroke_ml;
+        plant.cup_heat += plant.stroke_ml * plant.t_water;
+        plant.t_water += plant.stroke_ml * PLANT_C_ML * (plant.ambient - plant.t_water) / PLANT_C_WATER;
+    }
+
+    if (plant.ntc != PLANT_NTC_LOOSE) {
+        plant.t_sensor += (plant.t_water - plant.t_sensor) * dt / PLANT_TAU_SENSOR;
+    }
+}
+
+/**
+ * Advance physics to the given time and sample the outputs.
+ *
+ * @param now Current time.
+ */
+void plant_observe(sim_time_t now) {
+    double halves = (double) now * 2 * plant.mains_hz / F_CPU;
+    unsigned long half = (unsigned long) halves;
+    unsigned char pump_gate = (DDRA & ~PORTA & (1 << TRIAC_PUMP_pin)) != 0;    // Outputs driven low, off after reset.
+    unsigned char boiler_gate = (DDRA & ~PORTA & (1 << TRIAC_BOILER_pin)) != 0;
+
+    while (plant_half < half) {                     // Gate state at the start of each new half-cycle.
+        plant_finish_half();
+        plant_half++;
+        plant_pump = pump_gate;
+        plant_boiler = boiler_gate;
+    }
+
+    double conduction = plant_conduction(halves - half);
+    if (pump_gate && plant_pump < conduction) {
+        plant_pump = conduction;
+    }
+    if (boiler_gate && plant_boiler < conduction) {
+        plant_boiler = conduction;
+    }
+    if (boiler_gate && !plant_boiler_gate) {
+        plant.boiler_since = now;
+    }
+    plant_boiler_gate = boiler_gate;
+    if (pump_gate && !plant_pump_gate) {            // Offset to the nearest zero crossing.
+        double phase = halves - half;
+        double offset = (phase < 0.5 ? phase : phase - 1) * 500000.0 / plant.mains_hz;
+        plant.pump_gate_min = offset < plant.pump_gate_min ? offset : plant.pump_gate_min;
+        plant.pump_gate_max = offset > plant.pump_gate_max ? offset : plant.pump_gate_max;
+    }
+    plant_pump_gate = pump_gate;
+
+    unsigned char leds = PORTA & PLANT_LEDS;
+    if (leds != plant.leds) {
+        plant.leds = leds;
+        plant.leds_since = now;
+    }
+    plant_time = now;
+}
+
+/**
+ * Analog input value.
+ *
+ * @param mux ADC multiplexer setting.
+ * @param now Current time.
+ * @return 10 bit ADC value.
+ */
+unsigned int plant_adc(unsigned char mux, sim_time_t now) {
+    double volts = 0;
+    if (mux == ZERO_CROSSING_adc) {                 // Rectified mains through 1:1 divider and 5V1 zener.
+        if (plant.zero_sampled && now - plant.zero_sampled > plant.zero_gap) {
+            plant.zero_gap = now - plant.zero_sampled;
+        }
+        plant.zero_sampled = now;
+        volts = (PLANT_MAINS_PEAK * fabs(sin(2 * M_PI * plant.mains_hz * now / F_CPU)) - 1.4) / 2;
+        if (volts > 5.1) {
+            volts = 5.1;
+        }
+    } else if (mux == SENSOR_MAGNET_adc) {          // Hall switch closes between 60 and 100 ml.
+        double level = (plant.tank_ml - 60.0) / 40.0;
+        volts = 0.2 + 3.8 * (level < 0 ? 0 : level > 1 ? 1 : level);
+    } else if (mux == SENSOR_TEMP_adc && plant.ntc == PLANT_NTC_SHORT) {
+        volts = 5.0;
+    } else if (mux == SENSOR_TEMP_adc && plant.ntc != PLANT_NTC_OPEN) {    // NTC to VCC, series resistor to GND.
+        double r = PLANT_NTC_R25 * exp(PLANT_NTC_BETA * (1 / (plant.t_sensor + 273.15) - 1 / 298.15));
+        volts = 5.0 * PLANT_NTC_RS / (PLANT_NTC_RS + r);
+    }
+
+    int value = (int) (volts / 5.0 * 1023) + rand() % (2 * PLANT_ADC_NOISE + 1) - PLANT_ADC_NOISE;
+    return value < 0 ? 0 : value > 1023 ? 1023 : value;
+}
+
+/**
+ * Convert an NTC reading to a temperature.
+ *
+ * @param adc 10 bit ADC value.
+ * @return Temperature in °C.
+ */
+double plant_ntc_temperature(unsigned int adc) {
+    double r = PLANT_NTC_RS * (1023.0 / adc - 1);
+    return 1 / (1 / 298.15 + log(r / PLANT_NTC_R25) / PLANT_NTC_BETA) - 273.15;
+}
+
+/**
+ * Check if exactly one LED is lit without blinking.
+ *
+ * @param pin LED pin on port A.
+ * @param ms  Minimum time the LED has been on.
+ * @return 1 if lit steadily.
+ */
+unsigned char plant_led_steady(unsigned char pin, unsigned long ms) {
+    return plant.leds == (1 << pin) && plant_time - plant.leds_since >= ms * SIM_CYCLES_PER_MS;
+}
+
+/**
+ * @return Average temperature of the water delivered since last reset.
+ */
+double plant_cup_temperature(void) {
+    return plant.cup_ml > 0 ? plant.cup_heat / plant.cup_ml : 0;
+}
+
+/**
+ * Start a new cup.
+ */
+void plant_cup_reset(void) {
+    plant.cup_ml = 0;
+    plant.cup_heat = 0;
+}
+
+/**
+ * UART receiver on the trace output. The line only changes at simulated
+ * events, so the level seen at the previous call holds for all bit centers
+ * up to now.
+ *
+ * @param now Current time.
+ */
+void plant_serial(sim_time_t now) {
+    double bit = (double) F_CPU / PLANT_SERIAL_BAUD;
+    unsigned char level = (TRACE_TX_w >> TRACE_TX_pin) & 1;
+
+    while (serial_start > 0 && serial_start + (serial_bit + 0.5) * bit < now) {
+        serial_frame |= serial_level << serial_bit;
+        if (++serial_bit < 10) {
+            continue;
+        }
+        if ((serial_frame & 0x201) != 0x200) {      // Start bit low, stop bit high.
+            plant.serial_errors++;
+        } else {
+            if (plant.serial_len < PLANT_SERIAL_SIZE) {
+                plant.serial[plant.serial_len] = serial_frame >> 1;
+            }
+            plant.serial_len++;
+        }
+        serial_start = 0;
+    }
+    if (serial_start == 0 && serial_level && !level) {     // Start bit edge.
+        serial_start = now;
+        serial_bit = 0;
+        serial_frame = 0;
+    }
+    serial_level = level;
+}
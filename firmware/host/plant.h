@@ -0,0 +1,90 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   plant.h
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Simulated coffee machine (mains, boiler, pump, tank, LEDs)
+ */
+
+#ifndef PLANT_H
+#define PLANT_H
+
+#include "sim.h"
+
+#define PLANT_TANK_ML       750.0   // Full water tank (ml).
+#define PLANT_SERIAL_BAUD   2400    // Trace receiver (8N1).
+#define PLANT_SERIAL_SIZE   65536   // Received trace bytes kept.
+
+// NTC faults.
+#define PLANT_NTC_OK        0
+#define PLANT_NTC_OPEN      1       // Broken wire, input pulled to GND.
+#define PLANT_NTC_SHORT     2       // Input at VCC.
+#define PLANT_NTC_LOOSE     3       // Detached from the boiler, keeps its temperature.
+
+/**
+ * Plant state and statistics.
+ */
+struct plant {
+    // Configuration.
+    double mains_hz;            // Mains frequency.
+    double ambient;             // Ambient and inlet water temperature (°C).
+    double boiler_watts;        // Heating power.
+    double stroke_ml;           // Volume per pump stroke.
+    double scale;               // Limescale: fraction of heating power lost before reaching the water.
+    unsigned char ntc;          // NTC fault (PLANT_NTC_*).
+
+    // Physical state.
+    double t_block;             // Heating element and block temperature (°C).
+    double t_water;             // Boiler water temperature (°C).
+    double t_sensor;            // NTC temperature (°C).
+    double tank_ml;             // Water in tank.
+
+    // Statistics.
+    unsigned long strokes;      // Pump strokes delivered.
+    unsigned long boiler_halves;// Half-cycles with boiler conducting.
+    sim_time_t boiler_since;    // Time the boiler gate was last switched on.
+    double cup_ml;              // Volume delivered since last reset.
+    double cup_heat;            // Volume weighted temperature sum of the cup.
+    double boiler_joules;       // Heat energy delivered.
+    unsigned char leds;         // Current LED outputs (LED_*_pin bits of PORTA).
+    sim_time_t leds_since;      // Time of last LED change.
+    unsigned char serial[PLANT_SERIAL_SIZE];    // Bytes received on the trace output.
+    unsigned long serial_len;   // Bytes received (also beyond the buffer).
+    unsigned long serial_errors;// Frames without valid stop bit.
+    sim_time_t zero_sampled;    // Time of the last zero crossing sample.
+    sim_time_t zero_gap;        // Longest time between zero crossing samples.
+    double pump_gate_min;       // Earliest pump gate relative to the zero crossing (us).
+    double pump_gate_max;       // Latest pump gate relative to the zero crossing (us).
+};
+
+extern struct plant plant;
+
+// Prototypes:
+void plant_init(void);                                          //  Cold machine, full tank.
+void plant_observe(sim_time_t now);                             //  Advance physics to now.
+unsigned int plant_adc(unsigned char mux, sim_time_t now);      //  Analog input value.
+double plant_ntc_temperature(unsigned int adc);                 //  Convert NTC reading to °C.
+unsigned char plant_led_steady(unsigned char pin, unsigned long ms);    //  LED on without blinking.
+double plant_cup_temperature(void);                             //  Average temperature of cup.
+void plant_cup_reset(void);                                     //  Start a new cup.
+void plant_serial(sim_time_t now);                              //  Receive the trace output.
+
+#endif
@@ -0,0 +1,977 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   scenarios.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Simulator scenarios and entry point
+ *
+ * Each scenario runs in a forked process on a freshly reset firmware and
+ * prints its results as "scenario.key=value" lines. Failed checks are
+ * reported as "scenario.FAIL=..." and make the simulator exit non-zero.
+ *
+ * Usage: SenseoControl-2.0-sim [-f HZ] [-l CYCLES] [-t FILE] [SCENARIO...]
+ *
+ * -t writes the bytes received on the trace output to FILE (see
+ * tools/trace_decode.c), use it with a single scenario.
+ */
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../hal.h"
+#include "../main.h"
+#include "../adc.h"
+#include "../energy.h"
+#include "../ntc.h"
+#include "../scale.h"
+#include "../supervisor.h"
+#include "../trace.h"
+#include "../zerocross.h"
+#include "plant.h"
+#include "sim.h"
+
+#define READY_STEADY_MS     600     // Green LED on without blink means ready.
+#define HEATUP_MS           180000  // Duration of heat-up scenario.
+#define HOLD_MS             90000   // Final part of heat-up scenario evaluated for the band.
+#define SETTLE_BAND         3.0     // Band around target for settling (°C).
+#define WATCHDOG_MS         65.5    // Simulated SUPERVISOR_WATCHDOG timeout (ms).
+#define DECIMATION_MS       (ADC_SCAN_SLOTS * ADC_OVERSAMPLING * ADC_CONVERSION_US / 1000.0)   // Period of the decimated NTC values.
+
+static const char *scenario_name;   // Running scenario.
+static double scenario_hz;          // Mains frequency override (0 for default).
+static const char *trace_file;      // Trace output file (NULL for none).
+
+/**
+ * Print a result line.
+ */
+static void report(const char *key, const char *format, ...) {
+    va_list args;
+    printf("%s.%s=", scenario_name, key);
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+}
+
+/**
+ * Report a failed check.
+ *
+ * @return 1 if the check failed.
+ */
+static int check(int condition, const char *description) {
+    if (!condition) {
+        report("FAIL", "%s", description);
+    }
+    return !condition;
+}
+
+/**
+ * @return Water temperature corresponding to the operating temperature setting.
+ */
+static double target_temperature(void) {
+    return OPERATING_TEMPERATURE;
+}
+
+/**
+ * Push the power button.
+ */
+static void power_on(void) {
+    sim_press(BUTTON_POWER_pin, 0, 50);
+}
+
+/**
+ * Lift the tank off, fill it up and put it back.
+ */
+static void refill(void) {
+    plant.tank_ml = 0;
+    sim_run(500);
+    plant.tank_ml = PLANT_TANK_ML;
+    sim_run(500);
+}
+
+/**
+ * Run until the machine signals ready.
+ *
+ * @param timeout_ms Maximum time to wait.
+ * @return Time the ready signal started (seconds), negative on timeout.
+ */
+static double wait_ready(unsigned long timeout_ms) {
+    for (unsigned long t = 0; t < timeout_ms; t += 10) {
+        sim_run(10);
+        if (plant_led_steady(LED_GREEN_pin, READY_STEADY_MS)) {
+            return (double) plant.leds_since / F_CPU;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Run while tracking the water temperature range.
+ */
+static void run_sampled(unsigned long ms, double *min, double *max) {
+    for (unsigned long t = 0; t < ms; t += 100) {
+        sim_run(100);
+        if (plant.t_water < *min) {
+            *min = plant.t_water;
+        }
+        if (plant.t_water > *max) {
+            *max = plant.t_water;
+        }
+    }
+}
+
+/**
+ * Heat up from cold and hold the temperature.
+ * Settled means the water stays within SETTLE_BAND of the target until the end.
+ */
+static int scenario_heatup(void) {
+    double max = 0, hold_max = 0, hold_min = 1000, settled = -1;
+    power_on();
+    for (unsigned int t = 1; t <= HEATUP_MS / 100; t++) {
+        sim_run(100);
+        if (fabs(plant.t_water - target_temperature()) > SETTLE_BAND) {
+            settled = -1;
+        } else if (settled < 0) {
+            settled = sim_seconds();
+        }
+        if (plant.t_water > max) {
+            max = plant.t_water;
+        }
+        if (t > (HEATUP_MS - HOLD_MS) / 100) {
+            hold_min = fmin(hold_min, plant.t_water);
+            hold_max = fmax(hold_max, plant.t_water);
+        }
+    }
+    double ready = plant_led_steady(LED_GREEN_pin, READY_STEADY_MS) ? (double) plant.leds_since / F_CPU : -1;
+
+    report("target_c", "%.1f", target_temperature());
+    report("ready_s", "%.2f", ready);
+    report("settled_s", "%.2f", settled);
+    report("overshoot_c", "%.2f", max - target_temperature());
+    report("band_c", "%.2f", hold_max - hold_min);
+    report("hold_c", "%.2f", (hold_max + hold_min) / 2);
+    return check(ready > 0, "machine not ready");
+}
+
+/**
+ * Heat up and compare the firmware's temperature and slope with the simulated sensor.
+ * The filter lag is evaluated while heating at full power in the range of fine table steps, the
+ * error while holding the temperature.
+ */
+static int scenario_sensor(void) {
+    int failed = 0;
+    double error = 0, lag = 0, slope_error = 0, last = plant.t_sensor;
+    power_on();
+    for (unsigned int t = 1; t <= 900; t++) {
+        sim_run(100);
+        double celsius = (double) ntc_temperature / (1 << NTC_FRAC);
+        double slope = (double) ntc_slope / (1 << NTC_FRAC);
+        if (t % 10 == 0) {                          // Sensor slope over the last second.
+            slope_error = fmax(slope_error, fabs(slope - (plant.t_sensor - last)));
+            last = plant.t_sensor;
+        }
+        if (t >= 600) {
+            error = fmax(error, fabs(celsius - plant.t_sensor));
+        } else if (slope > 1 && plant.t_sensor > 60) {
+            lag = fmax(lag, (plant.t_sensor - celsius) / slope);
+        }
+    }
+    report("error_c", "%.2f", error);
+    report("lag_s", "%.2f", lag);
+    report("slope_error_c_s", "%.2f", slope_error);
+    failed += check(error < 0.3, "temperature off");
+    failed += check(lag < 0.5, "temperature lagging");
+    failed += check(slope_error < 0.5, "slope off");
+    return failed;
+}
+
+/**
+ * Brew four cups of coffee back to back.
+ */
+static int scenario_brew(void) {
+    int failed = 0;
+    double min = 1000, max = 0, cup_min = 1000, cup_max = 0;
+    power_on();
+    double ready = wait_ready(300000);
+    failed += check(ready > 0, "machine not ready");
+    report("ready_s", "%.2f", ready);
+
+    for (int cup = 1; cup <= 4 && !failed; cup++) {
+        char key[32];
+        double start = sim_seconds();
+        plant_cup_reset();
+        sim_press(BUTTON_1_CUP_pin, 0, 200);
+        sim_run(1000);
+        ready = wait_ready(300000);
+        failed += check(ready > 0, "machine not ready after brewing");
+
+        snprintf(key, sizeof(key), "cup%d_ml", cup);
+        report(key, "%.1f", plant.cup_ml);
+        snprintf(key, sizeof(key), "cup%d_c", cup);
+        report(key, "%.1f", plant_cup_temperature());
+        snprintf(key, sizeof(key), "cup%d_cycle_s", cup);
+        report(key, "%.2f", ready - start);
+        if (plant_cup_temperature() < cup_min) {
+            cup_min = plant_cup_temperature();
+        }
+        if (plant_cup_temperature() > cup_max) {
+            cup_max = plant_cup_temperature();
+        }
+        failed += check(plant.cup_ml > 50, "no coffee delivered");
+        run_sampled(2000, &min, &max);
+    }
+    report("cup_band_c", "%.2f", cup_max - cup_min);
+    report("ready_band_c", "%.2f", max - min);
+    return failed;
+}
+
+/**
+ * Brew as many coffees as possible in 10 minutes, starting each as soon as the machine is ready.
+ */
+static int scenario_throughput(void) {
+    int failed = 0, cups = 0;
+    double first = 0, last = 0;
+    power_on();
+    failed += check(wait_ready(300000) > 0, "machine not ready");
+    double start = sim_seconds();
+    while (!failed && sim_seconds() - start < 600) {
+        if (plant.tank_ml < 300) {
+            refill();
+            failed += check(wait_ready(300000) > 0, "machine not ready after refill");
+        }
+        plant_cup_reset();
+        sim_press(BUTTON_1_CUP_pin, 0, 200);
+        sim_run(1000);
+        failed += check(wait_ready(300000) > 0, "machine not ready after brewing");
+        if (sim_seconds() - start <= 600) {
+            cups++;
+            last = plant_cup_temperature();
+            if (cups == 1) {
+                first = last;
+            }
+        }
+    }
+    report("cups_per_10min", "%d", cups);
+    report("first_cup_c", "%.1f", first);
+    report("last_cup_c", "%.1f", last);
+    return failed;
+}
+
+/**
+ * Queue four coffees, three of them while the first one is brewing.
+ */
+static int scenario_queue(void) {
+    int failed = 0, cups = 0;
+    double first = 0, last = 0, start, end = 0;
+    power_on();
+    failed += check(wait_ready(300000) > 0, "machine not ready");
+    start = sim_seconds();
+    sim_press(BUTTON_1_CUP_pin, 0, 200);
+    for (int i = 0; i < 3; i++) {
+        sim_press(BUTTON_1_CUP_pin, 5000 + 1000 * i, 200);
+    }
+    while (sim_seconds() - end < 60 && sim_seconds() - start < 600) {
+        unsigned long strokes = plant.strokes;
+        sim_run(100);
+        if (plant.strokes == strokes) {
+            continue;
+        }
+        if (sim_seconds() - end > 1.5) {            // Pump restarted: next cup.
+            if (cups == 1) {
+                first = plant_cup_temperature();
+            }
+            plant_cup_reset();
+            cups++;
+        }
+        end = sim_seconds();
+    }
+    last = plant_cup_temperature();
+    report("cups", "%d", cups);
+    report("total_s", "%.1f", end - start);
+    report("cup_cycle_s", "%.1f", (end - start) / cups);
+    report("first_cup_c", "%.1f", first);
+    report("last_cup_c", "%.1f", last);
+    failed += check(cups == 4, "queued cups missing");
+    return failed;
+}
+
+/**
+ * Brew one coffee. With dosing by strokes the volume must not depend on the mains frequency.
+ */
+static int scenario_dose(void) {
+    int failed = 0;
+    power_on();
+    failed += check(wait_ready(300000) > 0, "machine not ready");
+    plant_cup_reset();
+    plant.pump_gate_min = 1e9;
+    plant.pump_gate_max = -1e9;
+    unsigned long strokes = plant.strokes;
+    double start = sim_seconds(), last = start;
+    sim_press(BUTTON_1_CUP_pin, 0, 200);
+    for (unsigned int t = 0; t < 1000; t++) {
+        unsigned long before = plant.strokes;
+        sim_run(100);
+        if (plant.strokes != before) {
+            last = sim_seconds();
+        }
+    }
+    report("cup_ml", "%.1f", plant.cup_ml);
+    report("strokes", "%lu", plant.strokes - strokes);
+    report("pump_s", "%.1f", last - start);
+    report("gate_offset_us", "%.0f", plant.pump_gate_min);    // Pump gate relative to the zero crossing.
+    report("gate_jitter_us", "%.0f", plant.pump_gate_max - plant.pump_gate_min);
+#if DOSE_BY_STROKES
+    failed += check(fabs(plant.cup_ml - VOLUME_1_COFFEE) < 1.0, "wrong dose");
+#endif
+    return failed;
+}
+
+/**
+ * Long push for an espresso (shorter pump time with preinfusion break).
+ */
+static int scenario_espresso(void) {
+    int failed = 0;
+    double soak = 0, start = 0, last = 0;
+    power_on();
+    failed += check(wait_ready(300000) > 0, "machine not ready");
+    plant_cup_reset();
+    sim_press(BUTTON_1_CUP_pin, 0, 2000);
+    for (unsigned int t = 0; t < 600; t++) {        // Record first stroke and longest pause.
+        unsigned long strokes = plant.strokes;
+        sim_run(100);
+        if (plant.strokes != strokes) {
+            if (start == 0) {
+                start = sim_seconds();
+            } else if (sim_seconds() - last > soak) {
+                soak = sim_seconds() - last;
+            }
+            last = sim_seconds();
+        }
+    }
+    report("cup_ml", "%.1f", plant.cup_ml);
+    report("cup_c", "%.1f", plant_cup_temperature());
+    report("pump_s", "%.1f", last - start);
+    report("soak_s", "%.1f", soak);
+#if DOSE_BY_STROKES
+    failed += check(fabs(plant.cup_ml - VOLUME_1_ESPRESSO) < 1.0, "wrong espresso volume");
+#endif
+    failed += check(soak > PREINFUSION_SOAK - 0.2, "no preinfusion");
+    return failed;
+}
+
+/**
+ * Brew coffees until the tank runs short. The last coffee must wait for a refill instead of running dry.
+ */
+static int scenario_shortage(void) {
+    int failed = 0, cups = 0;
+    power_on();
+    failed += check(wait_ready(300000) > 0, "machine not ready");
+    while (!failed && cups < 10) {
+        plant_cup_reset();
+        sim_press(BUTTON_1_CUP_pin, 0, 200);
+        sim_run(1000);
+        if (plant.cup_ml == 0) {                    // Refused.
+            break;
+        }
+        failed += check(wait_ready(300000) > 0, "machine not ready after brewing");
+        failed += check(plant.cup_ml > VOLUME_1_COFFEE - 5.0, "short coffee");
+        cups++;
+    }
+    double left = plant.tank_ml;
+    unsigned char leds = 0;
+    for (unsigned int t = 0; t < 50; t++) {        // Waiting for water.
+        sim_run(100);
+        leds |= plant.leds;
+    }
+    report("cups", "%d", cups);
+    report("left_ml", "%.1f", left);
+    failed += check(plant.cup_ml == 0, "brewed without enough water");
+    failed += check(leds == (1 << LED_BLUE_pin), "no water signal");
+
+    refill();
+    sim_run(60000);
+    report("refilled_cup_ml", "%.1f", plant.cup_ml);
+    failed += check(plant.cup_ml > VOLUME_1_COFFEE - 5.0, "queued coffee not brewed after refill");
+    return failed;
+}
+
+/**
+ * Energy accounting by the firmware: seconds to ready (cold and warm) and joules per cup.
+ * The counters must match the half-cycles seen by the plant.
+ */
+static int scenario_energy(void) {
+    int failed = 0;
+    double joules = plant.boiler_watts / (2 * plant.mains_hz);     // Per boiler half-cycle.
+    power_on();
+    double ready = wait_ready(300000);
+    failed += check(ready > 0, "machine not ready");
+    report("cold_ready_s", "%.2f", energy.ready / 4.0);
+    report("heatup_j", "%.0f", energy.heat_boiler * joules);
+    failed += check(energy.ready && fabs(energy.ready / 4.0 - ready) < 0.5, "heat-up time off");
+    failed += check(fabs(energy.heat_boiler * joules - plant.boiler_joules) < 0.01 * plant.boiler_joules,
+            "boiler energy off");
+
+    double cups = 0;
+    unsigned long strokes = plant.strokes;
+    for (int cup = 1; cup <= 3 && !failed; cup++) {
+        char key[32];
+        sim_press(BUTTON_1_CUP_pin, 0, 200);
+        sim_run(1000);
+        failed += check(wait_ready(300000) > 0, "machine not ready after brewing");
+        snprintf(key, sizeof(key), "cup%d_j", cup);
+        report(key, "%.0f", energy.cup_boiler * joules);
+        cups += energy.cup_boiler * joules;
+        snprintf(key, sizeof(key), "cup%d_brew_s", cup);
+        report(key, "%.2f", energy.brew[ONE_COFFEE - 1] / 4.0);
+        failed += check(labs((long) energy.cup_pump - (long) (plant.strokes - strokes)) <= 2, "pump count off");
+        strokes = plant.strokes;
+    }
+    report("j_per_cup", "%.0f", cups / 3);
+    report("session_j", "%.0f", 16 * energy.session_boiler * joules);
+    report("plant_j", "%.0f", plant.boiler_joules);
+    failed += check(fabs(16 * energy.session_boiler * joules - plant.boiler_joules) < 0.01 * plant.boiler_joules,
+            "session boiler energy off");
+    failed += check(labs(16L * energy.session_pump - (long) plant.strokes) <= 16 + 6, "session pump count off");
+
+    sim_press(BUTTON_POWER_pin, 0, 200);            // Off, cool down for ten minutes, on again.
+    sim_run(600000);
+    power_on();
+    failed += check(wait_ready(300000) > 0, "machine not ready after restart");
+    report("warm_ready_s", "%.2f", energy.ready / 4.0);
+    failed += check(energy.ready && energy.ready / 4.0 < ready, "warm heat-up not recorded");
+    return failed;
+}
+
+#if TRACE
+/**
+ * Brew one coffee and check the records received on the trace output.
+ */
+static int scenario_trace(void) {
+    int failed = 0;
+    unsigned long records = 0, lost = 0, strokes = 0, time = 0;
+    unsigned int last_strokes = 0;
+    unsigned char brewing = 0, valid = 1;
+    power_on();
+    failed += check(wait_ready(300000) > 0, "machine not ready");
+    sim_press(BUTTON_1_CUP_pin, 0, 200);
+    sim_run(1000);
+    failed += check(wait_ready(300000) > 0, "machine not ready after brewing");
+    sim_run(1000);
+
+    for (unsigned long i = 0; i + TRACE_RECORD <= plant.serial_len && i + TRACE_RECORD <= PLANT_SERIAL_SIZE;
+            i += TRACE_RECORD) {
+        unsigned int ms = plant.serial[i] | plant.serial[i + 1] << 8;
+        unsigned int word = plant.serial[i + 2] | plant.serial[i + 3] << 8;
+        unsigned int value = word & 0x0FFF;
+        unsigned long unwrapped = (time & ~0xFFFFUL) | ms;
+        if (unwrapped < time) {
+            unwrapped += 0x10000;
+        }
+        valid &= (word >> 12) <= TR_LAST;           // Unknown type or sensor gap: misaligned.
+        valid &= !(TRACE & TRACE_SENSORS) || unwrapped - time < 1000;
+        time = unwrapped;
+        records++;
+        switch (word >> 12) {
+            case TR_LOST:
+                lost += value;
+                break;
+            case TR_STATE:
+                brewing |= (value & 0x0F) == M_BREWING;
+                break;
+            case TR_PUMP:
+                strokes += (unsigned char) (value - last_strokes);
+                last_strokes = value;
+                break;
+        }
+    }
+    report("bytes", "%lu", plant.serial_len);
+    report("records", "%lu", records);
+    report("lost", "%lu", lost);
+    report("framing_errors", "%lu", plant.serial_errors);
+    report("strokes", "%lu", strokes);
+    report("plant_strokes", "%lu", plant.strokes);
+    failed += check(records > 0, "no trace received");
+    failed += check(plant.serial_errors == 0, "framing errors");
+    failed += check(valid, "records misaligned");
+    failed += check(!(TRACE & TRACE_STATE) || brewing, "brewing transition missing");
+    failed += check(!(TRACE & TRACE_SENSORS) || labs((long) strokes - (long) plant.strokes) <= 2,
+            "pump strokes differ");
+    return failed;
+}
+#endif
+
+/**
+ * Switch off and let the machine cool down to ambient temperature.
+ */
+static void cool_down(void) {
+    sim_press(BUTTON_POWER_pin, 0, 200);
+    sim_run(1000);
+    plant.t_block = plant.t_water = plant.t_sensor = plant.ambient;
+}
+
+/**
+ * Run until the green LED is on without blinking (ready), with or without
+ * red flashes (descaling recommended).
+ *
+ * @param descale Set if red flashes were seen.
+ * @return 1 if ready.
+ */
+static int wait_green(int *descale) {
+    unsigned int steady = 0;
+    *descale = 0;
+    for (unsigned long t = 0; t < 300000 && steady < READY_STEADY_MS; t += 10) {
+        sim_run(10);
+        steady = (plant.leds & (1 << LED_GREEN_pin)) ? steady + 10 : 0;
+        *descale |= steady && (plant.leds & (1 << LED_RED_pin));
+    }
+    return steady >= READY_STEADY_MS;
+}
+
+/**
+ * Heat-ups from cold while limescale builds up. The first sessions continue
+ * a wrapped EEPROM history and learn the reference, descaling has to be
+ * signalled once a quarter of the heating power is lost.
+ */
+static int scenario_scale(void) {
+    int failed = 0, descale = 0, session;
+    for (unsigned char slot = 0; slot < SCALE_SLOTS; slot++) {     // Newest record (sequence 1) in slot 4.
+        sim_eeprom[2 * slot] = (slot <= 4) ? (252 + slot) % 255 : 220 + slot;
+        sim_eeprom[2 * slot + 1] = 99;
+    }
+    for (session = 0; session < 12 && !descale; session++) {
+        char key[32];
+        plant.scale = (session < 4) ? 0 : 0.25;
+        power_on();
+        failed += check(wait_green(&descale), "machine not ready");
+        snprintf(key, sizeof(key), "rate%d", session);
+        report(key, "%.2f", sim_eeprom[2 * ((5 + session) % SCALE_SLOTS) + 1] / 64.0);
+        cool_down();
+    }
+    report("reference", "%.2f", sim_eeprom[SCALE_EE_BASELINE] / 64.0);
+    report("scaled_sessions", "%d", session - 4);
+    report("eeprom_writes", "%lu", sim_eeprom_writes);
+    failed += check(sim_eeprom[2 * 5] == 2 && sim_eeprom[2 * 6] == 3, "history not continued after newest record");
+    failed += check(sim_eeprom[SCALE_EE_BASELINE] != SCALE_ERASED, "no reference learned");
+    failed += check(descale && session > 4, "descaling not signalled");
+    failed += check(sim_eeprom_writes == 2 * (unsigned long) session + 1, "unexpected EEPROM writes");
+    return failed;
+}
+
+/**
+ * Run for some time and estimate the average supply current.
+ *
+ * @param ms   Duration.
+ * @param load CPU load in percent (share of active cycles).
+ * @return Current in uA.
+ */
+static double run_current(unsigned long ms, double *load) {
+    sim_time_t since[SIM_CPU_STATES];
+    memcpy(since, sim_cpu_cycles, sizeof(since));
+    sim_time_t start = sim_now;
+    sim_run(ms);
+    *load = 100.0 * (sim_cpu_cycles[SIM_ACTIVE] - since[SIM_ACTIVE]) / (sim_now - start);
+    return sim_current(since);
+}
+
+/**
+ * Supply current and CPU load of the controller per phase and latency from the power
+ * button push to the first boiler half-cycle.
+ */
+static int scenario_power(void) {
+    int failed = 0;
+    sim_run(1000);
+    double load;
+    report("off_ua", "%.1f", run_current(5000, &load));
+
+    sim_time_t push = sim_now;
+    power_on();
+    for (unsigned int ms = 0; ms < 1000 && plant.boiler_since < push; ms++) {
+        sim_run(1);
+    }
+    double latency = (double) (plant.boiler_since - push) / SIM_CYCLES_PER_MS;
+    report("wake_to_boiler_ms", "%.1f", plant.boiler_since < push ? -1.0 : latency);
+    failed += check(plant.boiler_since >= push && latency <= 1000.0 / plant.mains_hz, "boiler not on within one mains cycle");
+
+    report("heating_ua", "%.0f", run_current(10000, &load));
+    report("heating_load_percent", "%.1f", load);
+    failed += check(wait_ready(300000) > 0, "machine not ready");
+    double ready = run_current(10000, &load);
+    report("ready_ua", "%.0f", ready);
+    report("ready_load_percent", "%.1f", load);
+    sim_press(BUTTON_1_CUP_pin, 0, 100);
+    report("brewing_ua", "%.0f", run_current(10000, &load));
+    report("brewing_load_percent", "%.1f", load);
+    failed += check(ready < (SIM_ACTIVE_UA + SIM_IDLE_UA) / 2, "no idle sleep while ready");
+    return failed;
+}
+
+/**
+ * Rinse until the tank is empty. Boiler stays off while pumping.
+ */
+static int scenario_clean(void) {
+    int failed = 0;
+    power_on();
+    sim_run(5000);
+    plant.tank_ml = 200;
+    sim_press(BUTTON_1_CUP_pin, 0, 100);
+    sim_press(BUTTON_2_CUP_pin, 0, 100);
+    sim_run(1000);
+    unsigned long halves = plant.boiler_halves;
+    double start = plant.tank_ml;
+    failed += check(plant_led_steady(LED_BLUE_pin, 500), "no clean signal");
+    for (unsigned int t = 0; t < 120 && plant.strokes && plant.tank_ml > 0; t++) {
+        unsigned long strokes = plant.strokes;
+        sim_run(1000);
+        if (plant.strokes == strokes) {
+            break;
+        }
+    }
+    report("rinsed_ml", "%.1f", start - plant.tank_ml);
+    report("left_ml", "%.1f", plant.tank_ml);
+    report("boiler_halves", "%lu", plant.boiler_halves - halves);
+    failed += check(plant.boiler_halves == halves, "boiler on while rinsing");
+    failed += check(start - plant.tank_ml > 50, "no water rinsed");
+    unsigned long strokes = plant.strokes;
+    sim_run(2000);
+    failed += check(plant.strokes == strokes, "pump running on empty tank");
+    failed += check(plant.leds == 0 || plant.leds == (1 << LED_BLUE_pin), "no water signal");
+    return failed;
+}
+
+/**
+ * Descaling program, started by holding all three buttons. The first tank
+ * runs empty during the bursts and the machine is switched off meanwhile,
+ * the second one at the end of the drain. Both times the program continues
+ * after the refill instead of starting over, and ends with an unheated rinse.
+ */
+static int scenario_descale(void) {
+    int failed = 0;
+    power_on();
+    failed += check(wait_ready(300000) > 0, "machine not ready");
+    plant.tank_ml = 250;                                    // Solution for about 3 bursts.
+    unsigned long strokes = plant.strokes;
+    sim_press(BUTTON_1_CUP_pin, 0, BUTTON_DESCALE_THR + 500);
+    sim_press(BUTTON_2_CUP_pin, 0, BUTTON_DESCALE_THR + 500);
+    sim_press(BUTTON_POWER_pin, 200, BUTTON_DESCALE_THR + 200);
+    sim_run(BUTTON_DESCALE_THR + 1000);
+    failed += check(sim_state == M_DESCALING && plant.leds == ((1 << LED_RED_pin) | (1 << LED_BLUE_pin)),
+                    "descaling not started");
+    failed += check(plant.strokes == strokes, "pumped before the first soak");
+
+    unsigned long start = plant.strokes, rinse = 0, halves = 0, rinse_halves = 0;
+    unsigned int pauses = 0, soaks = 0, idle = 0;
+    double water_min = 100;
+    for (unsigned int t = 0; t < 3600 && (sim_state == M_DESCALING || sim_state == M_WATER_EMPTY); t++) {
+        sim_run(1000);
+        idle = (plant.strokes == strokes) ? idle + 1 : 0;
+        strokes = plant.strokes;
+        if (rinse && sim_state == M_DESCALING) {            // Boiler while rinsing, not after.
+            rinse_halves = plant.boiler_halves - halves;
+        }
+        if (idle == DESCALE_SOAK / 2) {                     // Long pump pauses are soaks.
+            soaks++;
+            water_min = plant.t_water < water_min ? plant.t_water : water_min;
+        }
+        if (sim_state != M_WATER_EMPTY) {
+            continue;
+        }
+        failed += check(plant.leds & (1 << LED_RED_pin), "no pause signal");
+        if (++pauses == 1) {                                // Tank empty during the bursts: switch off meanwhile.
+            report("first_tank_ml", "%.1f", (plant.strokes - start) * plant.stroke_ml);
+            failed += check(soaks < 6, "first tank did not run empty during the bursts");
+            sim_press(BUTTON_POWER_pin, 0, 2 * BUTTON_THRESHOLD);
+            sim_run(1000);
+            failed += check(sim_state == M_OFF, "not switched off");
+            refill();
+            power_on();
+            sim_run(1000);
+            failed += check(sim_state == M_DESCALING, "not continued after power on");
+        } else {                                            // Drained: refill with fresh water.
+            report("solution_ml", "%.1f", (plant.strokes - start) * plant.stroke_ml);
+            refill();
+            rinse = plant.strokes;
+            halves = plant.boiler_halves;
+        }
+    }
+    report("soaks", "%u", soaks);
+    report("pauses", "%u", pauses);
+    report("soak_min_c", "%.1f", water_min);
+    report("rinse_ml", "%.1f", rinse ? (plant.strokes - rinse) * plant.stroke_ml : 0);
+    report("rinse_boiler_halves", "%lu", rinse_halves);
+    failed += check(soaks == 6, "soaks repeated or skipped");
+    failed += check(pauses == 2, "no pause on the empty tank");
+    failed += check(water_min > OPERATING_TEMPERATURE - 5, "soak not heated");
+    failed += check(rinse && fabs((plant.strokes - rinse) * plant.stroke_ml - DESCALE_RINSE_ML) < 20, "no rinse");
+    failed += check(rinse && !rinse_halves, "boiler on while rinsing");
+    failed += check(sim_state != M_DESCALING && sim_state != M_WATER_EMPTY, "program did not end");
+    failed += check(wait_ready(300000) > 0, "not ready after descaling");
+    return failed;
+}
+
+/**
+ * Hold a button while heating. Boiler control must not stall.
+ */
+static int scenario_hold(void) {
+    power_on();
+    sim_run(2000);
+    unsigned long halves = plant.boiler_halves;
+    sim_press(BUTTON_1_CUP_pin, 0, 3000);
+    sim_run(3000);
+    report("boiler_halves", "%lu", plant.boiler_halves - halves);
+    return check(plant.boiler_halves - halves > 250, "boiler stalled while button held");
+}
+
+/**
+ * Switch off AUTO_OFF_THRESHOLD after wake-up without action.
+ */
+static int scenario_autooff(void) {
+    int failed = 0;
+    power_on();
+    failed += check(wait_ready(300000) > 0, "machine not ready");
+    while (plant.leds && sim_seconds() < AUTO_OFF_THRESHOLD + 10) {
+        sim_run(100);
+    }
+    report("off_s", "%.1f", sim_seconds());
+    failed += check(sim_seconds() >= AUTO_OFF_THRESHOLD, "switched off early");
+    unsigned long halves = plant.boiler_halves;
+    sim_run(2000);
+    failed += check(plant.leds == 0 && plant.boiler_halves == halves, "machine still on");
+    return failed;
+}
+
+/**
+ * Lock onto the mains frequency.
+ */
+static int scenario_mains(void) {
+    int failed = 0;
+    power_on();
+    sim_run(2000);
+    zc_reset_jitter();
+    plant.zero_gap = 0;
+    unsigned char count = zc_half_cycles;
+    sim_run(1000);
+    count = zc_half_cycles - count;
+
+    report("frequency_hz", "%u", zc_frequency());
+    report("period_ticks", "%u", zc_period());
+    report("half_cycles_per_s", "%u", count);
+    report("jitter_us", "%lu", zc_jitter() * 1000000UL / ZC_TICKS_PER_SEC);
+    report("resolution_us", "%llu", plant.zero_gap * 1000000ULL / F_CPU);  // Longest zero crossing sample gap.
+    failed += check(zc_frequency() == (unsigned char) plant.mains_hz, "wrong mains frequency");
+    failed += check(count >= 2 * plant.mains_hz - 1 && count <= 2 * plant.mains_hz + 1, "half-cycles missed");
+    return failed;
+}
+
+/**
+ * Run until the machine enters the fault state.
+ *
+ * @param timeout_ms Maximum time to wait.
+ * @return Milliseconds until the fault state, negative on timeout.
+ */
+static double wait_fault(unsigned long timeout_ms) {
+    sim_time_t from = sim_now;
+    for (unsigned long t = 0; t < timeout_ms && sim_state != M_FAULT; t++) {
+        sim_run(1);
+    }
+    return sim_state == M_FAULT ? (double) (sim_now - from) / SIM_CYCLES_PER_MS : -1;
+}
+
+/**
+ * Check the fault state: outputs off, steady red LED. Then switch off and on again.
+ *
+ * @param name Fault name for the failure message.
+ * @return Number of failed checks.
+ */
+static int check_fault(const char *name) {
+    int failed = 0;
+    char description[64];
+    sim_run(20);                                    // Half-cycle in progress.
+    unsigned long halves = plant.boiler_halves, strokes = plant.strokes;
+    sim_run(1000);
+    snprintf(description, sizeof(description), "outputs on after %s", name);
+    failed += check(plant.boiler_halves == halves && plant.strokes == strokes, description);
+    snprintf(description, sizeof(description), "no red light after %s", name);
+    failed += check(plant_led_steady(LED_RED_pin, 500), description);
+    plant.ntc = PLANT_NTC_OK;
+    sim_press(BUTTON_POWER_pin, 0, 2 * BUTTON_THRESHOLD);  // Off.
+    sim_run(1000);
+    power_on();                                     // On again.
+    sim_run(2000);
+    snprintf(description, sizeof(description), "no heating after %s", name);
+    failed += check(sim_state == M_HEATING && plant.boiler_halves > halves, description);
+    return failed;
+}
+
+/**
+ * Inject faults while heating and measure the detection latency against the
+ * documented worst case of the supervisor.
+ */
+static int scenario_supervisor(void) {
+    int failed = 0;
+    double bound, latency;
+    power_on();
+    sim_run(5000);
+
+    plant.ntc = PLANT_NTC_OPEN;
+    latency = wait_fault(10000);
+    bound = 2 * DECIMATION_MS + SUPERVISOR_NTC + 2;   // 2 ms for the timer tick and the sampling here.
+    report("ntc_open_ms", "%.0f", latency);
+    failed += check(latency >= 0 && latency <= bound, "open NTC not detected in time");
+    failed += check_fault("open NTC");
+
+    plant.ntc = PLANT_NTC_SHORT;
+    latency = wait_fault(10000);
+    report("ntc_short_ms", "%.0f", latency);
+    failed += check(latency >= 0 && latency <= bound, "shorted NTC not detected in time");
+    failed += check_fault("shorted NTC");
+
+    sim_stall = 1;
+    latency = wait_fault(10000);
+    bound = SUPERVISOR_STALL + WATCHDOG_MS + 2;
+    report("stall_ms", "%.0f", latency);
+    failed += check(latency >= 0 && latency <= bound && sim_resets == 1, "stalled main loop not reset in time");
+    failed += check_fault("main loop stall");
+
+    sim_stall = 2;
+    latency = wait_fault(10000);
+    bound = WATCHDOG_MS + 2;
+    report("stall_cli_ms", "%.0f", latency);
+    failed += check(latency >= 0 && latency <= bound && sim_resets == 2, "stalled interrupts not reset in time");
+    failed += check_fault("interrupt stall");
+
+    // Detached NTC early in a rise check and just after one passed (worst case).
+    bound = 2 * SUPERVISOR_HEAT / 4.0 + 1;
+    for (unsigned char worst = 0; worst < 2; worst++) {
+        plant.t_block = plant.t_water = plant.t_sensor = plant.ambient;
+        sim_press(BUTTON_POWER_pin, 0, 2 * BUTTON_THRESHOLD);
+        sim_run(1000);
+        power_on();
+        sim_run(worst ? 250 * SUPERVISOR_HEAT + 1000 : 1000);
+        plant.ntc = PLANT_NTC_LOOSE;
+        latency = wait_fault(120000) / 1000;
+        report(worst ? "loose_worst_s" : "loose_s", "%.1f", latency);
+        report(worst ? "loose_worst_water_c" : "loose_water_c", "%.1f", plant.t_water);
+        failed += check(latency >= 0 && latency <= bound, "detached NTC not detected in time");
+        failed += check_fault("detached NTC");
+    }
+    return failed;
+}
+
+static const struct {
+    const char *name;
+    double hz;
+    int (*run)(void);
+} scenarios[] = {
+    {"heatup", 50, scenario_heatup},
+    {"sensor", 50, scenario_sensor},
+    {"brew",   50, scenario_brew},
+    {"espresso", 50, scenario_espresso},
+    {"clean",  50, scenario_clean},
+    {"descale", 50, scenario_descale},
+    {"hold",   50, scenario_hold},
+    {"autooff", 50, scenario_autooff},
+    {"throughput", 50, scenario_throughput},
+    {"queue", 50, scenario_queue},
+    {"shortage", 50, scenario_shortage},
+    {"energy", 50, scenario_energy},
+    {"scale", 50, scenario_scale},
+    {"power", 50, scenario_power},
+    {"supervisor", 50, scenario_supervisor},
+#if TRACE
+    {"trace", 50, scenario_trace},
+#endif
+    {"dose50", 50, scenario_dose},
+    {"dose60", 60, scenario_dose},
+    {"mains50", 50, scenario_mains},
+    {"mains60", 60, scenario_mains},
+};
+
+#define SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+/**
+ * Run one scenario in a child process.
+ *
+ * @return Number of failed checks.
+ */
+static int run_scenario(unsigned int index) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        scenario_name = scenarios[index].name;
+        sim_start();
+        plant.mains_hz = scenario_hz > 0 ? scenario_hz : scenarios[index].hz;
+        int failed = scenarios[index].run();
+        report("sim_s", "%.1f", sim_seconds());
+        if (trace_file) {
+            FILE *file = fopen(trace_file, "wb");
+            unsigned long len = plant.serial_len < PLANT_SERIAL_SIZE ? plant.serial_len : PLANT_SERIAL_SIZE;
+            failed += check(file && fwrite(plant.serial, 1, len, file) == len, "trace file not written");
+            if (file) {
+                fclose(file);
+            }
+        }
+        fflush(stdout);
+        _exit(failed > 100 ? 100 : failed);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status)) {
+        printf("%s.FAIL=crashed\n", scenarios[index].name);
+        return 1;
+    }
+    return WEXITSTATUS(status);
+}
+
+int main(int argc, char **argv) {
+    int opt, failed = 0, selected = 0;
+    while ((opt = getopt(argc, argv, "f:l:t:")) != -1) {
+        if (opt == 'f') {
+            scenario_hz = atof(optarg);
+        } else if (opt == 'l') {
+            sim_loop_cycles = atoi(optarg);
+        } else if (opt == 't') {
+            trace_file = optarg;
+        } else {
+            printf( "Usage: %s [-f HZ] [-l CYCLES] [-t FILE] [SCENARIO...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    for (unsigned int i = 0; i < SCENARIOS; i++) {
+        int run = optind == argc;
+        for (int a = optind; a < argc; a++) {
+            run |= !strcmp(argv[a], scenarios[i].name);
+        }
+        if (run) {
+            failed += run_scenario(i);
+            selected++;
+        }
+    }
+    if (!selected) {
+        printf( "No such scenario\n");
+        return 2;
+    }
+    return failed ? 1 : 0;
+}
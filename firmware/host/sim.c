@@ -0,0 +1,656 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   sim.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Host simulator core
+ *
+ * The firmware runs unmodified in a coroutine. Simulated time only advances
+ * at hal_yield() (one main loop pass of sim_loop_cycles) and hal_sleep().
+ * Timer 0, timer 1 (overflow and compare A with its OC1A output), the ADC,
+ * EEPROM writes and INT0 are modelled as discrete events, which call the
+ * firmware interrupt handlers at their exact due time. Analog inputs, triac/LED
+ * outputs and the serial trace output are connected to the plant model.
+ *
+ * Time is accounted per CPU state (active, idle, power-down) for a supply
+ * current estimate. Interrupt handlers run in zero time, each one is charged
+ * SIM_IRQ_CYCLES of active time taken from the sleep it interrupted.
+ *
+ * The watchdog resets the MCU when it is not reset in time: registers and
+ * peripherals return to their reset state, the firmware data and bss (which
+ * the Makefile collects into the fw_data and fw_bss sections) to their
+ * initial contents, and the firmware restarts on a fresh stack. sim_stall
+ * injects a hang of the main loop to exercise it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include "../hal.h"
+#include "../main.h"
+#include "plant.h"
+#include "sim.h"
+
+#define SIM_STACK_SIZE      (256 * 1024)
+#define SIM_FIRMWARE_DATA   4096    // Capacity for the initial firmware data.
+
+// Registers.
+volatile unsigned char PORTA, PINA, DDRA, PORTB, PINB, DDRB;
+volatile unsigned char ADCSRA, ADMUX, ADCL, ADCH;
+volatile unsigned char TCCR0B, TCNT0L, OCR0A, TCCR1A, TCCR1B, TCNT1, OCR1A, OCR1B, OCR1C;
+volatile unsigned char TIMSK, TIFR, GIMSK, MCUCR, MCUSR, SREG;
+volatile unsigned char EEAR, EEDR, EECR;
+
+// Firmware entry point and interrupt handlers (weak, modules may omit them).
+int firmware_main(void);
+void INT0_vect(void) __attribute__((weak));
+void TIMER1_OVF_vect(void) __attribute__((weak));
+void TIMER1_COMPA_vect(void) __attribute__((weak));
+void TIMER0_OVF_vect(void) __attribute__((weak));
+void TIMER0_COMPA_vect(void) __attribute__((weak));
+void ADC_vect(void) __attribute__((weak));
+void EE_RDY_vect(void) __attribute__((weak));
+
+// Firmware data and bss (sections renamed by the Makefile).
+extern char __start_fw_data[] __attribute__((weak)), __stop_fw_data[] __attribute__((weak));
+extern char __start_fw_bss[] __attribute__((weak)), __stop_fw_bss[] __attribute__((weak));
+
+// variables:
+sim_time_t sim_now;                         // Current simulated time.
+unsigned int sim_loop_cycles = 100;         // Cost of one main loop pass.
+unsigned char sim_eeprom[SIM_EEPROM_SIZE];  // EEPROM contents.
+unsigned long sim_eeprom_writes;            // EEPROM bytes written.
+sim_time_t sim_cpu_cycles[SIM_CPU_STATES];  // Cycles spent in each CPU state.
+unsigned char sim_state;                    // State machine state reported by the firmware.
+void (*sim_monitor)(void);                  // Called after every simulated event.
+unsigned char sim_stall;                    // Injected main loop hang (cleared by reset).
+unsigned long sim_resets;                   // Watchdog resets.
+
+static char sim_stack[2][SIM_STACK_SIZE];   // Firmware stacks, alternating on reset.
+static unsigned char sim_stack_index;       // Stack of the running firmware.
+static char sim_firmware_data[SIM_FIRMWARE_DATA];  // Initial contents of fw_data.
+static ucontext_t sim_scenario_ctx;         // Scenario (caller of sim_run).
+static ucontext_t sim_firmware_ctx;         // Firmware coroutine.
+static sim_time_t sim_target;               // End of current sim_run().
+
+static unsigned char sim_sleeping;          // CPU in sleep mode.
+static unsigned char sim_frozen;            // Clocks stopped (power-down).
+static unsigned char sim_woken;             // Interrupt executed during sleep.
+
+static unsigned char t1_running;            // Timer 1 clock.
+static sim_time_t t1_start;                 // Time of timer 1 tick 0.
+static unsigned char t1a_ocr = 0xFF;        // Compare value of the scheduled match.
+static sim_time_t t1a_next;                 // Next compare match A (0 if not scheduled).
+static unsigned char t1a_flag;              // OCF1A (firmware clears it by writing 1 to TIFR).
+static unsigned char t0_running;            // Timer 0 clock.
+static sim_time_t t0_start;                 // Time of timer 0 tick 0.
+static unsigned char t0a_ocr;               // Compare value of the scheduled match.
+static sim_time_t t0a_next;                 // Next compare match A (0 if not scheduled).
+static unsigned char t0a_flag;              // OCF0A (firmware clears it by writing 1 to TIFR).
+static unsigned char adc_busy;              // Conversion running.
+static unsigned char adc_first = 1;         // Next conversion is the first (25 clocks).
+static unsigned char adc_mux;               // Latched multiplexer.
+static sim_time_t adc_done;                 // End of conversion.
+static sim_time_t int0_last = ~0ULL;        // Last INT0 execution.
+static sim_time_t ee_done;                  // End of EEPROM write (0 if idle).
+static unsigned char ee_address;            // Latched EEPROM write.
+static unsigned char ee_data;
+static sim_time_t wdt_period;               // Watchdog timeout (0 if disabled).
+static sim_time_t wdt_due;                  // Watchdog expiry.
+
+static struct {
+    unsigned char pin;
+    sim_time_t from;
+    sim_time_t to;
+} sim_presses[SIM_PRESSES];
+static unsigned char sim_press_count;
+
+/**
+ * Execute an interrupt handler if interrupts are enabled.
+ *
+ * @param vector Handler.
+ * @return 1 if executed.
+ */
+static unsigned char sim_irq(void (*vector)(void)) {
+    if (!(SREG & 0x80)) {
+        return 0;
+    }
+    SREG &= 0x7F;
+    if (vector) {
+        vector();
+    }
+    SREG |= 0x80;
+    sim_woken = 1;
+    if (sim_sleeping) {
+        unsigned char state = sim_frozen ? SIM_POWER_DOWN : SIM_IDLE;
+        if (sim_cpu_cycles[state] >= SIM_IRQ_CYCLES) {
+            sim_cpu_cycles[state] -= SIM_IRQ_CYCLES;
+            sim_cpu_cycles[SIM_ACTIVE] += SIM_IRQ_CYCLES;
+        }
+    }
+    return 1;
+}
+
+static sim_time_t t0_prescaler(void) {
+    static const unsigned int factors[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+    return factors[TCCR0B & 0x07];
+}
+
+static sim_time_t t1_prescaler(void) {
+    unsigned char cs = TCCR1B & 0x0F;
+    return cs ? (1ULL << (cs - 1)) : 0;
+}
+
+static sim_time_t t1_overflow(void) {
+    return t1_start + (OCR1C + 1) * t1_prescaler();        // Counts from 0 to OCR1C.
+}
+
+static sim_time_t t0_overflow(void) {
+    return t0_start + 256 * t0_prescaler();                 // 8 bit mode, counts from 0 to 255.
+}
+
+/**
+ * Schedule the next timer 0 compare match A. A value the counter has already passed matches in the next period.
+ */
+static void t0a_schedule(void) {
+    t0a_ocr = OCR0A;
+    t0a_next = t0_start + t0a_ocr * t0_prescaler();
+    if (t0a_next <= sim_now) {
+        t0a_next += 256 * t0_prescaler();
+    }
+}
+
+/**
+ * Apply the compare output mode of OC1A (PB1).
+ */
+static void t1a_output(void) {
+    switch ((TCCR1A >> COM1A0) & 0x03) {
+        case 1:
+            PORTB ^= (1 << 1);
+            break;
+        case 2:
+            PORTB &= (unsigned char) ~(1 << 1);
+            break;
+        case 3:
+            PORTB |= (1 << 1);
+            break;
+    }
+}
+
+/**
+ * Schedule the next compare match A. A value the counter has already passed matches in the next period.
+ */
+static void t1a_schedule(void) {
+    sim_time_t ps = t1_prescaler();
+    t1a_ocr = OCR1A;
+    t1a_next = t1_start + t1a_ocr * ps;
+    if (t1a_next <= sim_now) {
+        t1a_next += (OCR1C + 1) * ps;
+    }
+}
+
+static sim_time_t adc_clocks(unsigned char clocks) {
+    unsigned char ps = ADCSRA & 0x07;
+    return (sim_time_t) clocks << (ps ? ps : 1);
+}
+
+/**
+ * Pick up register writes of the firmware (timer start/stop, ADC start).
+ */
+static void sim_sync(void) {
+    if ((TCCR0B & 0x07) && !t0_running) {
+        t0_running = 1;
+        t0_start = sim_now - TCNT0L * t0_prescaler();
+        t0a_next = 0;
+    } else if (!(TCCR0B & 0x07)) {
+        t0_running = 0;
+    }
+    TCCR0B &= (unsigned char) ~(1 << PSR0);
+    if (t0_running && (!t0a_next || OCR0A != t0a_ocr)) {
+        t0a_schedule();
+    }
+    if (TIFR & (1 << OCF0A)) {                      // Flag cleared by writing 1.
+        TIFR &= (unsigned char) ~(1 << OCF0A);
+        t0a_flag = 0;
+    }
+
+    if ((TCCR1B & 0x0F) && !t1_running) {
+        t1_running = 1;
+        t1_start = sim_now;
+        t1a_next = 0;
+    } else if (!(TCCR1B & 0x0F)) {
+        t1_running = 0;
+    }
+    if (t1_running && (!t1a_next || OCR1A != t1a_ocr)) {
+        t1a_schedule();
+    }
+    if (TCCR1A & (1 << FOC1A)) {                    // Forced compare (reads as zero).
+        TCCR1A &= (unsigned char) ~(1 << FOC1A);
+        t1a_output();
+    }
+    if (TIFR & (1 << OCF1A)) {                      // Flag cleared by writing 1.
+        TIFR &= (unsigned char) ~(1 << OCF1A);
+        t1a_flag = 0;
+    }
+
+    if ((EECR & (1 << EEPE)) && !ee_done) {
+        if (EECR & (1 << EEMPE)) {                  // Write started.
+            ee_done = sim_now + SIM_EEPROM_WRITE;
+            ee_address = EEAR;
+            ee_data = EEDR;
+        } else {                                    // Ignored without master write enable.
+            EECR &= (unsigned char) ~(1 << EEPE);
+        }
+    }
+    EECR &= (unsigned char) ~(1 << EEMPE);          // Cleared by hardware after four cycles.
+
+    if (!(ADCSRA & (1 << ADEN))) {
+        adc_busy = 0;
+        adc_first = 1;
+        ADCSRA &= (unsigned char) ~(1 << ADSC);
+    } else if ((ADCSRA & (1 << ADSC)) && !adc_busy) {
+        adc_busy = 1;
+        adc_mux = ADMUX;
+        adc_done = sim_now + adc_clocks(adc_first ? 25 : 14);         // Started on the next ADC clock edge.
+        adc_first = 0;
+    }
+}
+
+/**
+ * Update button inputs from the script.
+ */
+static void sim_inputs(void) {
+    unsigned char pinb = 0xFF;
+    for (unsigned char i = 0; i < sim_press_count; i++) {
+        if (sim_now >= sim_presses[i].from && sim_now < sim_presses[i].to) {
+            pinb &= (unsigned char) ~(1 << sim_presses[i].pin);
+        }
+    }
+    PINB = pinb;
+    PINA = PORTA;
+}
+
+/**
+ * @return Time of the next peripheral or input event, limited to until.
+ */
+static sim_time_t sim_next_event(sim_time_t until) {
+    sim_time_t next = until;
+    if (!sim_frozen) {
+        if (t1_running && t1_overflow() < next) {
+            next = t1_overflow();
+        }
+        if (t0_running && t0_overflow() < next) {
+            next = t0_overflow();
+        }
+        if (t0_running && t0a_next && t0a_next < next) {
+            next = t0a_next;
+        }
+        if (t1_running && t1a_next && t1a_next < next) {
+            next = t1a_next;
+        }
+        if (adc_busy && adc_done < next) {
+            next = adc_done;
+        }
+    }
+    if (ee_done && ee_done < next) {                // Also completes in sleep.
+        next = ee_done;
+    }
+    if (wdt_period && wdt_due < next) {             // Own oscillator, also runs in sleep.
+        next = wdt_due;
+    }
+    for (unsigned char i = 0; i < sim_press_count; i++) {
+        if (sim_presses[i].from > sim_now && sim_presses[i].from < next) {
+            next = sim_presses[i].from;
+        }
+        if (sim_presses[i].to > sim_now && sim_presses[i].to < next) {
+            next = sim_presses[i].to;
+        }
+    }
+    return next < sim_now ? sim_now : next;
+}
+
+static void sim_entry(void) {
+    firmware_main();
+    fprintf(stderr, "firmware terminated\n");
+    exit(2);
+}
+
+/**
+ * Reset registers, peripherals and firmware data and prepare the firmware coroutine.
+ *
+ * @param flags Reset cause (MCUSR bits).
+ */
+static void sim_reset(unsigned char flags) {
+    PORTA = PINA = DDRA = PORTB = DDRB = 0;
+    PINB = 0xFF;
+    ADCSRA = ADMUX = ADCL = ADCH = 0;
+    TCCR0B = TCNT0L = OCR0A = TCCR1A = TCCR1B = TCNT1 = OCR1A = OCR1B = 0;
+    OCR1C = 0xFF;
+    TIMSK = TIFR = GIMSK = MCUCR = SREG = 0;
+    EEAR = EEDR = EECR = 0;
+    MCUSR |= flags;
+
+    sim_sleeping = sim_frozen = sim_woken = 0;
+    t1_running = t1a_flag = t0_running = t0a_flag = adc_busy = 0;
+    t1a_ocr = 0xFF;
+    t1a_next = t0a_next = 0;
+    adc_first = 1;
+    wdt_period = 0;
+    sim_stall = 0;
+
+    memcpy(__start_fw_data, sim_firmware_data, __stop_fw_data - __start_fw_data);
+    memset(__start_fw_bss, 0, __stop_fw_bss - __start_fw_bss);
+
+    sim_stack_index ^= 1;                           // The old stack may still be in use.
+    getcontext(&sim_firmware_ctx);
+    sim_firmware_ctx.uc_stack.ss_sp = sim_stack[sim_stack_index];
+    sim_firmware_ctx.uc_stack.ss_size = SIM_STACK_SIZE;
+    sim_firmware_ctx.uc_link = NULL;
+    makecontext(&sim_firmware_ctx, sim_entry, 0);
+}
+
+/**
+ * Execute all events due at the current time.
+ */
+static void sim_events(void) {
+    if (wdt_period && sim_now >= wdt_due) {         // Watchdog reset, restart the firmware.
+        sim_resets++;
+        sim_reset(1 << WDRF);
+        setcontext(&sim_firmware_ctx);
+    }
+
+    if (!sim_frozen) {
+        if (t1_running && sim_now >= t1_overflow()) {
+            t1_start = t1_overflow();
+            TCNT1 = 0;
+            if (!(TIMSK & (1 << TOIE1)) || !sim_irq(TIMER1_OVF_vect)) {
+                TIFR |= (1 << TOV1);
+            }
+            sim_sync();
+        }
+        if (t1_running) {
+            TCNT1 = (sim_now - t1_start) / t1_prescaler();
+        }
+
+        if (t1_running && t1a_next && sim_now >= t1a_next) {
+            t1a_next = 0;
+            t1a_output();
+            t1a_flag = 1;
+            if ((TIMSK & (1 << OCIE1A)) && sim_irq(TIMER1_COMPA_vect)) {
+                t1a_flag = 0;
+            }
+            sim_sync();
+        }
+
+        if (t0_running && sim_now >= t0_overflow()) {
+            t0_start = t0_overflow();
+            if (!(TIMSK & (1 << TOIE0)) || !sim_irq(TIMER0_OVF_vect)) {
+                TIFR |= (1 << TOV0);
+            }
+            sim_sync();
+        }
+
+        if (t0_running && t0a_next && sim_now >= t0a_next) {
+            t0a_next = 0;
+            t0a_flag = 1;
+            if ((TIMSK & (1 << OCIE0A)) && sim_irq(TIMER0_COMPA_vect)) {
+                t0a_flag = 0;
+            }
+            sim_sync();
+        }
+
+        if (adc_busy && sim_now >= adc_done) {
+            unsigned int value = plant_adc(adc_mux & 0x1F, sim_now);
+            if (adc_mux & (1 << ADLAR)) {
+                ADCL = (value & 0x03) << 6;
+                ADCH = value >> 2;
+            } else {
+                ADCL = value & 0xFF;
+                ADCH = value >> 8;
+            }
+            ADCSRA |= (1 << ADIF);
+            if (ADCSRA & (1 << ADATE)) {                      // Free running: next conversion starts now.
+                adc_mux = ADMUX;
+                adc_done = sim_now + adc_clocks(13);
+            } else {
+                adc_busy = 0;
+                ADCSRA &= (unsigned char) ~(1 << ADSC);
+            }
+            if ((ADCSRA & (1 << ADIE)) && sim_irq(ADC_vect)) {
+                ADCSRA &= (unsigned char) ~(1 << ADIF);
+            }
+            sim_sync();
+        }
+    }
+
+    if (ee_done && sim_now >= ee_done) {
+        sim_eeprom[ee_address & (SIM_EEPROM_SIZE - 1)] = ee_data;
+        sim_eeprom_writes++;
+        ee_done = 0;
+        EECR &= (unsigned char) ~(1 << EEPE);
+        if (!sim_frozen && (EECR & (1 << EERIE)) && sim_irq(EE_RDY_vect)) {
+            sim_sync();
+        }
+    }
+
+    // INT0 is level triggered (low level on PB6).
+    if ((GIMSK & (1 << INT0)) && !(PINB & (1 << 6)) && int0_last != sim_now) {
+        int0_last = sim_now;
+        sim_irq(INT0_vect);
+        sim_sync();
+    }
+}
+
+/**
+ * Deliver interrupts which became pending while interrupts were disabled.
+ */
+static void sim_pending(void) {
+    if ((TIFR & (1 << TOV1)) && (TIMSK & (1 << TOIE1)) && sim_irq(TIMER1_OVF_vect)) {
+        TIFR &= (unsigned char) ~(1 << TOV1);
+    }
+    if (t1a_flag && (TIMSK & (1 << OCIE1A)) && sim_irq(TIMER1_COMPA_vect)) {
+        t1a_flag = 0;
+    }
+    if ((TIFR & (1 << TOV0)) && (TIMSK & (1 << TOIE0)) && sim_irq(TIMER0_OVF_vect)) {
+        TIFR &= (unsigned char) ~(1 << TOV0);
+    }
+    if (t0a_flag && (TIMSK & (1 << OCIE0A)) && sim_irq(TIMER0_COMPA_vect)) {
+        t0a_flag = 0;
+    }
+    if ((ADCSRA & (1 << ADIF)) && (ADCSRA & (1 << ADIE)) && sim_irq(ADC_vect)) {
+        ADCSRA &= (unsigned char) ~(1 << ADIF);
+    }
+    if (!sim_frozen && (EECR & (1 << EERIE)) && !ee_done && sim_irq(EE_RDY_vect)) {    // Level triggered.
+        sim_sync();
+    }
+}
+
+/**
+ * Advance simulated time. Stops early when the CPU wakes up from sleep.
+ *
+ * @param until Target time.
+ */
+static void sim_advance(sim_time_t until) {
+    sim_sync();
+    plant_serial(sim_now);                          // Output written by the firmware.
+    sim_pending();
+    sim_inputs();
+    sim_events();
+    plant_serial(sim_now);
+    while (sim_now < until && !(sim_sleeping && sim_woken)) {
+        sim_time_t next = sim_next_event(until);
+        sim_cpu_cycles[!sim_sleeping ? SIM_ACTIVE : sim_frozen ? SIM_POWER_DOWN : SIM_IDLE] += next - sim_now;
+        sim_now = next;
+        plant_observe(sim_now);
+        sim_inputs();
+        sim_events();
+        plant_serial(sim_now);
+        if (sim_monitor) {
+            sim_monitor();
+        }
+    }
+}
+
+/**
+ * Return control to the scenario if the current run is finished.
+ */
+static void sim_check_target(void) {
+    if (sim_now >= sim_target) {
+        swapcontext(&sim_firmware_ctx, &sim_scenario_ctx);
+    }
+}
+
+/**
+ * One main loop pass.
+ */
+void sim_yield(void) {
+    sim_check_target();
+    sim_advance(sim_now + sim_loop_cycles);
+    while (sim_stall) {                             // Hang until the watchdog resets (2: interrupts disabled).
+        if (sim_stall > 1) {
+            cli();
+        }
+        sim_check_target();
+        sim_advance(sim_now + sim_loop_cycles);
+    }
+}
+
+/**
+ * Sleep until an interrupt is executed.
+ */
+void sim_sleep(void) {
+    if (!(MCUCR & (1 << SE))) {
+        return;
+    }
+
+    unsigned char mode = (MCUCR >> SM0) & 0x03;
+    sim_time_t from = sim_now;
+    sim_sleeping = 1;
+    sim_frozen = (mode >= 2);                       // Power-down and standby stop all clocks.
+    sim_woken = 0;
+    while (!sim_woken) {
+        sim_check_target();
+        sim_advance(sim_target);
+    }
+    if (sim_frozen) {                               // Resume timers where they stopped.
+        t1_start += sim_now - from;
+        t1a_next += t1a_next ? sim_now - from : 0;
+        t0_start += sim_now - from;
+        t0a_next += t0a_next ? sim_now - from : 0;
+        adc_done += sim_now - from;
+    }
+    sim_sleeping = 0;
+    sim_frozen = 0;
+}
+
+/**
+ * Power-on reset of the MCU, prepare the firmware coroutine. The firmware data must be in its initial state.
+ */
+void sim_start(void) {
+    size_t size = __stop_fw_data - __start_fw_data;
+    if (size > sizeof(sim_firmware_data)) {
+        fprintf(stderr, "firmware data exceeds %d bytes\n", SIM_FIRMWARE_DATA);
+        exit(2);
+    }
+    memcpy(sim_firmware_data, __start_fw_data, size);
+    memset(sim_eeprom, 0xFF, sizeof(sim_eeprom));
+    plant_init();
+    MCUSR = 0;
+    sim_reset(1 << PORF);
+}
+
+/**
+ * Configure the watchdog (wdt_enable(), wdt_disable()), which restarts its period.
+ *
+ * @param timeout WDTO_* value, 0xFF to disable.
+ */
+void sim_watchdog(unsigned char timeout) {
+    wdt_period = timeout > WDTO_2S ? 0 : (sim_time_t) (16384UL << timeout) * (F_CPU / 1000) / 1000;
+    wdt_due = sim_now + wdt_period;
+}
+
+/**
+ * Reset the watchdog (wdt_reset()).
+ */
+void sim_wdr(void) {
+    wdt_due = sim_now + wdt_period;
+}
+
+/**
+ * Run the firmware.
+ *
+ * @param ms Simulated time in milliseconds.
+ */
+void sim_run(unsigned long ms) {
+    sim_target = sim_now + ms * SIM_CYCLES_PER_MS;
+    swapcontext(&sim_scenario_ctx, &sim_firmware_ctx);
+}
+
+/**
+ * @return Simulated time in seconds.
+ */
+double sim_seconds(void) {
+    return (double) sim_now / F_CPU;
+}
+
+/**
+ * Estimate the average supply current.
+ *
+ * @param since Copy of sim_cpu_cycles at the start of the interval.
+ * @return Current in uA, 0 for an empty interval.
+ */
+double sim_current(const sim_time_t *since) {
+    static const double currents[SIM_CPU_STATES] = {SIM_ACTIVE_UA, SIM_IDLE_UA, SIM_POWER_DOWN_UA};
+    double charge = 0, cycles = 0;
+    for (unsigned char i = 0; i < SIM_CPU_STATES; i++) {
+        charge += currents[i] * (sim_cpu_cycles[i] - since[i]);
+        cycles += sim_cpu_cycles[i] - since[i];
+    }
+    return cycles ? charge / cycles : 0;
+}
+
+/**
+ * Script a button push relative to the current time.
+ *
+ * @param pin      Button pin on port B.
+ * @param delay_ms Delay until the button is pushed.
+ * @param hold_ms  Time the button is held.
+ */
+void sim_press(unsigned char pin, unsigned long delay_ms, unsigned long hold_ms) {
+    if (sim_press_count == SIM_PRESSES) {                   // Drop expired entries.
+        unsigned char j = 0;
+        for (unsigned char i = 0; i < SIM_PRESSES; i++) {
+            if (sim_presses[i].to > sim_now) {
+                sim_presses[j++] = sim_presses[i];
+            }
+        }
+        sim_press_count = j;
+        if (j == SIM_PRESSES) {
+            fprintf(stderr, "button script full\n");
+            exit(2);
+        }
+    }
+    sim_presses[sim_press_count].pin = pin;
+    sim_presses[sim_press_count].from = sim_now + delay_ms * SIM_CYCLES_PER_MS;
+    sim_presses[sim_press_count].to = sim_presses[sim_press_count].from + hold_ms * SIM_CYCLES_PER_MS;
+    sim_press_count++;
+}
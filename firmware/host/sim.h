@@ -0,0 +1,64 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   sim.h
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Host simulator core
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#define SIM_CYCLES_PER_MS   (F_CPU / 1000)
+#define SIM_PRESSES         16      // Capacity of the button script.
+#define SIM_EEPROM_SIZE     512     // EEPROM bytes.
+#define SIM_EEPROM_WRITE    (F_CPU * 85 / 10000)    // EEPROM write time (8.5 ms).
+#define SIM_IRQ_CYCLES      60      // Average cost of an interrupt handler (incl. response and reti).
+
+// CPU states for current estimation, supply current typical at 5 V and about linear in the clock.
+#define SIM_ACTIVE          0
+#define SIM_IDLE            1
+#define SIM_POWER_DOWN      2
+#define SIM_CPU_STATES      3
+#define SIM_ACTIVE_UA       (600 + 1400 * (F_CPU / 1000000UL))
+#define SIM_IDLE_UA         (300 + 300 * (F_CPU / 1000000UL))
+#define SIM_POWER_DOWN_UA   1
+
+typedef unsigned long long sim_time_t;  // Simulated CPU cycles.
+
+extern sim_time_t sim_now;              // Current simulated time.
+extern unsigned int sim_loop_cycles;    // Cost of one main loop pass.
+extern unsigned char sim_eeprom[SIM_EEPROM_SIZE];   // EEPROM contents (erased on sim_start).
+extern unsigned long sim_eeprom_writes; // EEPROM bytes written.
+extern sim_time_t sim_cpu_cycles[SIM_CPU_STATES];   // Cycles spent in each CPU state.
+extern unsigned char sim_state;         // State machine state reported by the firmware (hal_state).
+extern void (*sim_monitor)(void);       // Called after every simulated event (NULL for none).
+extern unsigned char sim_stall;         // Injected main loop hang: 1 with, 2 without interrupts (reset clears).
+extern unsigned long sim_resets;        // Watchdog resets.
+
+// Prototypes:
+void sim_start(void);                                                   //  Reset MCU and start firmware.
+void sim_run(unsigned long ms);                                         //  Run firmware for some time.
+double sim_seconds(void);                                               //  Simulated time in seconds.
+double sim_current(const sim_time_t *since);                            //  Average supply current (uA).
+void sim_press(unsigned char pin, unsigned long delay_ms, unsigned long hold_ms);  //  Script a button push.
+
+#endif
@@ -23,29 +23,123 @@
  * @date   2013-04-22
  * @brief  Main program
  *
- * Platform:  ATtiny26
- *            Internal RC-oscillator 8 MHz, CKDIV8 Enabled
+ * Platform:  ATtiny861A
+ *            Internal RC-oscillator 1 MHz (8 MHz with make F_CPU=8000000)
  */
 
-#define F_CPU    1000000UL
-
 // includes
-#include <util/delay.h>
-#include <avr/interrupt.h>
-#include <avr/io.h>
+#include "hal.h"
 #include "main.h"
+#include "adc.h"
+#include "boiler.h"
+#include "buttons.h"
+#include "energy.h"
+#include "events.h"
+#include "ntc.h"
+#include "recipe.h"
+#include "scale.h"
+#include "supervisor.h"
+#include "ticks.h"
+#include "trace.h"
+#include "triac.h"
+#include "water.h"
+#include "zerocross.h"
 
 // variables:
-volatile unsigned int time_counter;                 // Global time counter (ms).
-volatile unsigned int user_time_counter = 0;        // Universal time counter (ms).
-volatile unsigned int sec_counter = 0;              // Second-counter (for AutoOff).
-volatile unsigned int button_1_cup_counter = 0;     // Left button counter (1 cup).
-volatile unsigned int button_2_cup_counter = 0;     // Left button counter (2 cups).
-volatile unsigned char button_power_counter = 0;    // Power button counter.
-volatile unsigned char led = 0;                     // LED status flags.
-volatile unsigned char state;                       // Water-, temperature-, clean-flags.
+static volatile unsigned char idle_seconds;         // Seconds since last action (for AutoOff).
+static volatile unsigned char led_pattern[2];      // LED port bits (blink on, blink off phase).
+static volatile unsigned char led_phases;           // Blink phases of the 2s frame (1 bit per 1/4 s).
+static unsigned char brew_queue[BREW_QUEUE_SIZE];   // Queued coffee modes.
+static unsigned char brew_head;                     // Next queued brew.
+static unsigned char brew_count;                    // Queued brews.
+volatile unsigned char state;                       // Water- and temperature-flags.
 volatile unsigned char make_coffee = NO_COFFEE;     // Coffee mode flag.
-volatile unsigned char pump_time = 0;               // Pump time.
+static unsigned char mode = M_OFF;                  // State machine state.
+static unsigned char descale_step;                  // Resume point of the descaling program (0: none).
+
+/**
+ * State transition. The first entry matching the current state (or M_ANY)
+ * and the event (or EV_ANY) is taken.
+ */
+typedef struct {
+    unsigned char mode;         // Current state.
+    unsigned char event;        // Triggering event.
+    unsigned char next;         // Next state.
+    unsigned char action;       // Action before entering the next state.
+} transition_t;
+
+// Actions.
+#define A_NONE      0
+#define A_QUEUE     1           // Queue coffee mode from button event.
+#define A_BREW      2           // Guard: only taken if a brew is queued.
+#define A_SEGMENT   3           // Guard: only taken if the brew profile continues.
+#define A_RESUME    4           // Guard: only taken if a descaling program is paused.
+
+static const transition_t transitions[] PROGMEM = {
+    {M_OFF,         EV_ANY,         M_OFF,          A_NONE},    // Waiting for power button release.
+    {M_ANY,         EV_POWER,       M_OFF,          A_NONE},
+    {M_FAULT,       EV_ANY,         M_FAULT,        A_NONE},    // Outputs off until switched off.
+    {M_ANY,         EV_FAULT,       M_FAULT,        A_NONE},
+    {M_ANY,         EV_WATER_LOW,   M_WATER_EMPTY,  A_NONE},
+    {M_RINSING,     EV_1_CUP,       M_IDLE,         A_NONE},    // Abort cleaning.
+    {M_RINSING,     EV_2_CUP,       M_IDLE,         A_NONE},
+    {M_RINSING,     EV_ANY,         M_ANY,          A_NONE},
+    {M_DESCALING,   EV_1_CUP,       M_IDLE,         A_NONE},    // Abort descaling.
+    {M_DESCALING,   EV_2_CUP,       M_IDLE,         A_NONE},
+    {M_DESCALING,   EV_DOSED,       M_ANY,          A_SEGMENT}, // Next program step.
+    {M_DESCALING,   EV_TIMER,       M_ANY,          A_SEGMENT},
+    {M_DESCALING,   EV_DOSED,       M_IDLE,         A_NONE},    // End of program.
+    {M_DESCALING,   EV_TIMER,       M_IDLE,         A_NONE},
+    {M_DESCALING,   EV_ANY,         M_ANY,          A_NONE},
+    {M_IDLE,        EV_TEMP_LOW,    M_DESCALING,    A_RESUME},  // Continue a paused program once the
+    {M_IDLE,        EV_TEMP_BAND,   M_DESCALING,    A_RESUME},  // tank is back (also after power off).
+    {M_IDLE,        EV_TEMP_OK,     M_DESCALING,    A_RESUME},
+    {M_WATER_EMPTY, EV_TEMP_LOW,    M_DESCALING,    A_RESUME},
+    {M_WATER_EMPTY, EV_TEMP_BAND,   M_DESCALING,    A_RESUME},
+    {M_WATER_EMPTY, EV_TEMP_OK,     M_DESCALING,    A_RESUME},
+    {M_ANY,         EV_1_CUP,       M_ANY,          A_QUEUE},   // Queue coffee in any other state.
+    {M_ANY,         EV_1_CUP_LONG,  M_ANY,          A_QUEUE},
+    {M_ANY,         EV_2_CUP,       M_ANY,          A_QUEUE},
+    {M_ANY,         EV_2_CUP_LONG,  M_ANY,          A_QUEUE},
+    {M_HEATING,     EV_CLEAN,       M_RINSING,      A_NONE},
+    {M_READY,       EV_CLEAN,       M_RINSING,      A_NONE},
+    {M_HEATING,     EV_DESCALE,     M_DESCALING,    A_NONE},    // Power button added to the clean push.
+    {M_READY,       EV_DESCALE,     M_DESCALING,    A_NONE},
+    {M_IDLE,        EV_TEMP_BAND,   M_BREWING,      A_BREW},    // Next cup as soon as back in band.
+    {M_IDLE,        EV_TEMP_OK,     M_BREWING,      A_BREW},
+    {M_IDLE,        EV_TEMP_LOW,    M_HEATING,      A_NONE},
+    {M_IDLE,        EV_TEMP_BAND,   M_HEATING,      A_NONE},
+    {M_IDLE,        EV_TEMP_OK,     M_READY,        A_NONE},
+    {M_WATER_EMPTY, EV_TEMP_LOW,    M_HEATING,      A_NONE},
+    {M_WATER_EMPTY, EV_TEMP_BAND,   M_HEATING,      A_NONE},
+    {M_WATER_EMPTY, EV_TEMP_OK,     M_READY,        A_NONE},
+    {M_HEATING,     EV_TEMP_BAND,   M_BREWING,      A_BREW},
+    {M_HEATING,     EV_TEMP_OK,     M_BREWING,      A_BREW},
+    {M_HEATING,     EV_TEMP_OK,     M_READY,        A_NONE},
+    {M_READY,       EV_TEMP_OK,     M_BREWING,      A_BREW},
+    {M_READY,       EV_TEMP_BAND,   M_HEATING,      A_NONE},
+    {M_READY,       EV_TEMP_LOW,    M_HEATING,      A_NONE},
+    {M_BREWING,     EV_DOSED,       M_ANY,          A_SEGMENT}, // Next profile segment.
+    {M_BREWING,     EV_TIMER,       M_ANY,          A_SEGMENT},
+    {M_BREWING,     EV_DOSED,       M_IDLE,         A_NONE},    // End of profile.
+    {M_BREWING,     EV_TIMER,       M_IDLE,         A_NONE},
+};
+
+// LED colors of the states (M_OFF .. M_DESCALING).
+static const unsigned char mode_leds[] PROGMEM = {0, 0, RED_BLINK, GREEN, GREEN_BLINK, BLUE, BLUE_BLINK, RED, VIOLET};
+
+// Coffee modes selected by the button events (EV_1_CUP .. EV_2_CUP_LONG).
+static const unsigned char coffee_modes[] PROGMEM = {ONE_COFFEE, ONE_ESPRESSO, TWO_COFFEE, TWO_ESPRESSO};
+
+// LED pins in order of the color flags (red, green, blue).
+static const unsigned char led_pins[] PROGMEM = {LED_RED_pin, LED_GREEN_pin, LED_BLUE_pin};
+
+static void dispatch(unsigned char event);
+static void enter(unsigned char next);
+static void activity(void);
+static void led_set(unsigned char flags, unsigned char flashes);
+static void led_update(void);
+static unsigned char brew_ready(void);
 
 /**
  * Main program.
@@ -54,55 +148,217 @@ volatile unsigned char pump_time = 0;               // Pump time.
  */
 int main(void) {
     init();                                                 // Initialization.
-    power_off();                                            // Power off after init sequence.
+    enter(supervisor_fault ? M_FAULT : M_OFF);              // Power off after init sequence,
+    led_update();                                           // fault state after a watchdog reset.
 
     while (1) {                                             // Main loop.
-        if (sec_counter >= AUTO_OFF_THRESHOLD) {
-            button_power_counter = BUTTON_THRESHOLD;        // Check for AutoOff Timer (generate OnOff-button push).
-        }
-
+        unsigned char tick = ticks_ms;                      // Low byte, read atomically.
+        hal_yield();
+        supervisor_heartbeat = 0;                           // Main loop alive.
         update_water();                                     // Update water state.
         update_temperature();                               // Update temperature.
+        energy_update();                                    // Boiler and pump on-time.
+        trace_sample();                                     // Sensor trace records.
+
+        if (supervisor_fault) {                             // Sensor event.
+            dispatch(EV_FAULT);
+        } else if (!is_set(state, S_WATER)) {
+            dispatch(EV_WATER_LOW);
+        } else if (is_set(state, S_TEMP)) {
+            dispatch(EV_TEMP_OK);
+        } else if (is_set(state, S_BAND)) {
+            dispatch(EV_TEMP_BAND);
+        } else {
+            dispatch(EV_TEMP_LOW);
+        }
 
-        if (button_power_counter >= BUTTON_THRESHOLD) {     // Button "OnOff" pushed:
-            set_bit(TRIAC_BOILER_w, TRIAC_BOILER_pin);      // Boiler off
-            make_coffee = NO_COFFEE;                        // Clear coffee flag.
-
-            while (button_power_counter > 0);               // Wait until button is released (debounce)
+        unsigned char event;
+        while ((event = event_get()) != EV_NONE) {          // Button and timer events.
+            dispatch(event);
+        }
 
-            power_off();                                    // Call power off sequence
+        if (mode == M_OFF && !is_set(buttons_down, BUTTON_POWER_pin)) {   // Power button released (debounced):
+            power_off();                                    // Sleep until next push.
+            enter(M_IDLE);
+        }
+        while (tick == (unsigned char) ticks_ms) {          // Idle until the next timer tick, the
+            hal_sleep();                                    // ADC interrupts wake up in between.
+        }
+    }
+}
 
-            button_power_counter = BUTTON_THRESHOLD;        // Debounce again after wake up
-            while (button_power_counter > 0);
+/**
+ * Look up and execute the transition for an event.
+ *
+ * @param event Event code.
+ */
+static void dispatch(unsigned char event) {
+    const transition_t *t;
+    for (t = transitions; t < transitions + sizeof(transitions) / sizeof(transitions[0]); t++) {
+        unsigned char from = pgm_read_byte(&t->mode);
+        unsigned char on = pgm_read_byte(&t->event);
+        if ((from == mode || from == M_ANY) && (on == event || on == EV_ANY)) {
+            unsigned char next = pgm_read_byte(&t->next);
+            unsigned char action = pgm_read_byte(&t->action);
+            if ((action == A_BREW && !brew_ready()) || (action == A_SEGMENT && !recipe_next())
+                    || (action == A_RESUME && !descale_step)) {
+                continue;                               // Nothing to brew, end of profile or no program paused.
+            }
+            if ((next != mode && next != M_ANY) || action != A_NONE) {
+                trace(TRACE_STATE, TR_STATE, (event << 4) | (next & 0x0F));
+            }
+            if (action == A_QUEUE && brew_count < BREW_QUEUE_SIZE) {
+                brew_queue[(brew_head + brew_count++) & (BREW_QUEUE_SIZE - 1)] =
+                        pgm_read_byte(&coffee_modes[event - EV_1_CUP]);
+                activity();
+            } else if (action == A_SEGMENT) {           // Long programs do not switch off.
+                activity();
+            }
+            if (next != mode && next != M_ANY) {
+                enter(next);
+            } else if (action != A_QUEUE) {
+                return;
+            }
+            led_update();
+            return;
         }
+    }
+}
 
-        process_buttons();
-
-        if (state & S_WATER) {                                  // Water OK:
-            if (state & S_CLEAN) {                              // If clean-flag is set:
-                do_clean();
-            } else if (state & S_TEMP) {                        // Temperature OK:
-                set_bit(TRIAC_BOILER_w, TRIAC_BOILER_pin);      // Boiler off.
-                led = GREEN;                                    // Set green LED.
-                if (make_coffee > NO_COFFEE) {                  // If coffee flag is set:
-                    do_coffee();
-                }
-            } else {                                            // Temperature too low.
-                clear_bit(TRIAC_BOILER_w, TRIAC_BOILER_pin);    // Boiler on.
-                if (make_coffee > NO_COFFEE) {                  // Set violet LED blink if coffee wish is saved.
-                    led = VIOLET_BLINK;
-                } else {                                        // Set red LED blink if no coffee wish is saved.
-                    led = RED_BLINK;
-                }
+/**
+ * Leave the current state and enter the next one.
+ *
+ * @param next Next state.
+ */
+static void enter(unsigned char next) {
+    if (mode == M_BREWING || mode == M_RINSING || mode == M_DESCALING) {   // Leave pumping states.
+        triac_pump_stop();
+        event_timer_start(0);
+        if (mode == M_BREWING) {
+            energy_brew_end();
+            make_coffee = NO_COFFEE;                    // Clear coffee flag.
+        }
+        if (mode == M_DESCALING) {                      // Finished or aborted, else paused.
+            descale_step = (next == M_IDLE) ? 0 : recipe_pause();
+        }
+    }
+    mode = next;
+    hal_state(next);
+
+    switch (next) {
+        case M_OFF:                                     // Outputs off, sleep after button release.
+            boiler_enable(0);
+            brew_count = 0;                             // Drop queue.
+            energy_off();
+            break;
+        case M_IDLE:                                    // Wait for sensor event.
+            activity();
+            break;
+        case M_HEATING:                                 // Heat up.
+            boiler_set(OPERATING_TEMPERATURE << NTC_FRAC);
+            boiler_enable(1);
+            break;
+        case M_READY:                                   // Hold temperature.
+            boiler_set(OPERATING_TEMPERATURE << NTC_FRAC);
+            boiler_enable(1);
+            energy_ready();
+            scale_ready(ntc_temperature);
+            break;
+        case M_BREWING:                                 // Next coffee from queue.
+            make_coffee = brew_queue[brew_head];
+            brew_head = (brew_head + 1) & (BREW_QUEUE_SIZE - 1);
+            brew_count--;
+            activity();
+            energy_ready();                             // Queued coffee counts as ready.
+            scale_ready(ntc_temperature);
+            energy_brew_start(make_coffee);
+            recipe_start(make_coffee);                  // Pump and boiler by brew profile.
+            break;
+        case M_RINSING:
+            // Pump water without additional heating, until the water tank is empty or a button is pushed.
+            boiler_enable(0);
+            triac_pump_dose(TRIAC_UNLIMITED);
+            triac_pump_run(255);                        // Trigger pump on every zero crossing.
+            break;
+        case M_DESCALING:                               // Start or continue the descaling program.
+            activity();
+            if (descale_step) {
+                recipe_resume(descale_step);
+            } else {
+                recipe_start(RECIPE_DESCALE);
             }
-        } else {                                                // Water too low:
-            set_bit(TRIAC_BOILER_w, TRIAC_BOILER_pin);          // Boiler off.
-            set_bit(TRIAC_PUMP_w, TRIAC_PUMP_pin);              // Pump off.
-            led = BLUE_BLINK;                                   // Set blue LED blink.
+            break;
+        case M_WATER_EMPTY:
+            boiler_enable(0);                           // Boiler off.
+            break;
+        case M_FAULT:                                   // Outputs off, red LED until switched off.
+            boiler_enable(0);
+            brew_count = 0;                             // Drop queue.
+            break;
+    }
+}
+
+/**
+ * Set LED colors for the current state. Blinking shows the number of queued brews.
+ */
+static void led_update(void) {
+    unsigned char flags = pgm_read_byte(&mode_leds[mode]);
+    if (mode == M_IDLE) {                               // Keep until next state.
+        return;
+    } else if (mode == M_WATER_EMPTY && descale_step) { // Red and violet alternating: descaling paused.
+        flags = RED | BLUE_BLINK;
+    } else if (mode != M_BREWING && brew_count && !brew_ready()) {  // Blue LED blink if water is short.
+        flags = BLUE_BLINK;
+    } else if (mode == M_HEATING && brew_count) {       // Violet LED blink if coffee is queued.
+        flags = VIOLET_BLINK;
+    } else if (mode == M_BREWING && IS_ESPRESSO(make_coffee)) { // Orange LED blink for espresso.
+        flags = ORANGE_BLINK;
+    } else if (mode == M_READY && scale_due()) {        // Green LED with orange flashes: descale.
+        flags = GREEN | RED_BLINK;
+    }
+    led_set(flags, brew_count);
+}
+
+/**
+ * Set LED colors. Precomputes the port bits for both blink phases.
+ *
+ * @param flags   LED color flags.
+ * @param flashes Number of short flashes per 2s instead of 1Hz blinking (0..4).
+ */
+static void led_set(unsigned char flags, unsigned char flashes) {
+    unsigned char on = 0, blink = 0;
+    for (unsigned char i = 0; i < sizeof(led_pins); i++, flags >>= 2) {
+        unsigned char bit = 1 << pgm_read_byte(&led_pins[i]);
+        if (flags & (1 << LED_RED_ON)) {
+            on |= bit;
         }
+        if (flags & (1 << LED_RED_BLINK)) {
+            blink |= bit;
+        }
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        led_pattern[0] = on | blink;
+        led_pattern[1] = on;
+        led_phases = flashes ? (unsigned char) ((1 << (2 * flashes)) - 1) & 0x55 : 0x33;
     }
 }
 
+/**
+ * Check whether the next queued coffee can be brewed with the water left.
+ *
+ * @return Non-zero if a coffee is queued and the tank holds enough water.
+ */
+static unsigned char brew_ready(void) {
+    return brew_count && water_left >= recipe_strokes(brew_queue[brew_head]);
+}
+
+/**
+ * Reset AutoOff timer.
+ */
+static void activity(void) {
+    idle_seconds = 0;
+}
+
 /**
  * Initializes relevant bits, timer and ADC.
  */
@@ -134,19 +390,21 @@ void init() {
     set_bit(TRIAC_PUMP_ddr, TRIAC_PUMP_pin);
     set_bit(TRIAC_PUMP_w, TRIAC_PUMP_pin);
 
-    ADCSR = (1 << ADEN) | (1 << ADPS1);                 // Enable ADC, prescaler division factor 4.
+    adc_init();                                         // Start ADC scan.
+    scale_init();                                       // Heating rate history.
+    trace_init();                                       // Trace output idle.
+    supervisor_init();                                  // Reset cause, watchdog.
 
     // TIMER1
-    set_bit(TCCR1B, CTC1);                              // Set timer 1 to CTC-Mode.
-    clear_bit(TCCR1B, CS11);                            // Prescaler 8.
-    set_bit(TCCR1B, CS12);
-    clear_bit(TCCR1B, CS11);
-    clear_bit(TCCR1B, CS10);
-    OCR1C = 124;                                        // Period of 1 ms.
+    TCCR1B = TIMER1_PRESCALER;                          // Timer 1 counts up to OCR1C, 8 us ticks.
+    OCR1C = TIMER1_TOP;                                 // Period of 1 ms.
+
+    set_bit(MCUCR, SE);                                 // Idle mode between interrupts, timers and ADC keep running.
 
     cli();                                              // Disable interrupts.
     clear_bit(GIMSK, INT0);                             // Disable interrupt 0.
     set_bit(TIMSK, TOIE1);                              // Activate timer 1.
+    set_bit(TIMSK, OCIE0A);                             // Activate timer 0 compare (triac gate scheduler).
     sei();                                              // Enable interrupts.
 }
 
@@ -154,6 +412,7 @@ void init() {
  * Clear bits and set controller to sleep mode.
  */
 void power_off(void) {
+    supervisor_sleep();                     // Watchdog off.
     cli();                                  // Disable interrupts.
     set_bit(GIMSK, INT0);                   // Activate interrupt 0 (for wake-up).
     clear_bit(TIMSK, TOIE1);                // Deactivate timer 1.
@@ -162,16 +421,25 @@ void power_off(void) {
     clear_bit(LED_RED_w, LED_RED_pin);      // Clear LED outputs.
     clear_bit(LED_GREEN_w, LED_GREEN_pin);
     clear_bit(LED_BLUE_w, LED_BLUE_pin);
+    trace_flush();                          // Send pending records, the clock stops.
+    adc_sleep();                            // ADC off.
 
     set_bit(MCUCR, SM1);                    // Activate power-down mode.
     clear_bit(MCUCR, SM0);
     set_bit(MCUCR, SE);
-    asm volatile("sleep"::);
+    hal_sleep();
 
     // Entrance point after wake-up.
-    time_counter = 0;                       // Reset counter.
-    sec_counter = 0;
+    clear_bit(MCUCR, SM1);                  // Back to idle mode.
+    idle_seconds = 0;                       // Reset AutoOff counter.
+    energy_wake();                          // New session.
+    scale_wake();                           // Heating rate of a cold start.
+    state &= (1 << S_WATER);
+    buttons_wake();                         // Ignore power button until released.
     cli();                                  // Disable interrupts.
+    adc_wake();                             // Restart scan, temperature is outdated after sleep.
+    ntc_wake();
+    supervisor_wake();                      // Clear faults, watchdog on.
     clear_bit(GIMSK, INT0);                 // Disable interrupt 0.
     set_bit(TIMSK, TOIE1);                  // Enable timer 1.
     sei();                                  // Re-enable interrupts.
@@ -181,11 +449,7 @@ void power_off(void) {
  * Checks hall sensor for water level.
  */
 void update_water(void) {
-    ADMUX = SENSOR_MAGNET_adc | (1 << ADLAR);
-    set_bit(ADCSR, ADSC);
-    loop_until_bit_is_clear(ADCSR, ADSC);
-    unsigned char sense = ADCH;
-    if (((state & S_WATER) && sense > WATER_LOW) || (!(state & S_WATER) && sense >= WATER_OK)) {
+    if (water_update()) {
         set_bit(state, S_WATER);
     } else {
         clear_bit(state, S_WATER);
@@ -193,165 +457,29 @@ void update_water(void) {
 }
 
 /**
- * Checks NTC sensor for temperature state.
+ * Checks NTC sensor for temperature state and runs the boiler controller.
+ * The controller runs on the latest temperature, also if it arrived before
+ * heating was enabled (the first sample after wake-up).
  */
 void update_temperature(void) {
-    ADMUX = SENSOR_TEMP_adc | (1 << ADLAR);
-    set_bit(ADCSR, ADSC);
-    loop_until_bit_is_clear(ADCSR, ADSC);
-    unsigned char sense = ADCH;
-    if (sense >= OPERATING_TEMPERATURE) {
+    unsigned char fresh = ntc_update();
+    unsigned int sense = ntc_temperature;
+    boiler_update(sense, ntc_slope);
+    if (!fresh) {
+        return;
+    }
+    scale_sample(sense);
+    if (is_set(state, S_TEMP) ? (sense >= ((OPERATING_TEMPERATURE - READY_BAND) << NTC_FRAC))
+                         : (sense >= (OPERATING_TEMPERATURE << NTC_FRAC))) {
         set_bit(state, S_TEMP);
     } else {
         clear_bit(state, S_TEMP);
     }
-}
-
-/**
- * Checks for zero crossing (with fixed offset)
- *
- * @return Raw ADC value.
- */
-unsigned int detect_zero_crossing() {
-    ADMUX = ZERO_CROSSING_adc;
-    set_bit(ADCSR, ADSC);
-    loop_until_bit_is_clear(ADCSR, ADSC);
-    unsigned char sense_L = ADCL;
-    unsigned char sense_H = ADCH;
-    return (sense_H << 8) | sense_L;
-}
-
-/**
- * Process button inputs and update states accordingly.
- */
-static void process_buttons(void) {
-    if (button_1_cup_counter >= BUTTON_CLEAN_THR && button_2_cup_counter >= BUTTON_CLEAN_THR) {
-        // Both coffee buttons pushed: enter clean mode.
-        set_bit(state, S_CLEAN);    // Set clean flag.
-        led = BLUE;                 // Set blue LED.
-        while (button_1_cup_counter > 0 && button_2_cup_counter > 0);   // Debounce buttons.
-    } else if (button_1_cup_counter >= BUTTON_THRESHOLD && button_2_cup_counter < BUTTON_THRESHOLD) {
-        // Left coffee button pushed: call espresso.
-        sec_counter = 0;    // Reset AutoOff counter.
-
-        if ((state & S_WATER) && (state & S_TEMP)) {            // Machine ready:
-            while (button_1_cup_counter > 0) {                  // Check if button is pushed long time.
-                if (button_1_cup_counter > BUTTON_LONG_THR) {   // Button pushed for a long time:
-                    make_coffee = ONE_ESPRESSO;                   // Set coffee flag to 1 (1 espresso).
-                    button_1_cup_counter = 0;                   // Clear button counter.
-                }
-            }
-            if (make_coffee != ONE_ESPRESSO) {
-                make_coffee = ONE_COFFEE;                       // Set coffee flag to 3 (1 coffee) otherwise.
-            }
-        } else if (COFFEE_WISH) {                               // Save coffee wish.
-            make_coffee = ONE_COFFEE;
-        }
-    } else if (button_1_cup_counter < BUTTON_THRESHOLD && button_2_cup_counter >= BUTTON_THRESHOLD) {
-        // Right coffee button pushed: call coffee.
-        sec_counter = 0;                                        // Reset AutoOff counter.
-
-        if ((state & S_WATER) && (state & S_TEMP)) {            // Machine ready:
-            while (button_2_cup_counter > 0) {                  // Check if button is pushed long time.
-                if (button_2_cup_counter > BUTTON_LONG_THR) {   // Button pushed for a long time:
-                    make_coffee = TWO_ESPRESSO;                 // Set coffee flag to 2 (2 espresso).
-                    button_2_cup_counter = 0;                   // Clear button counter.
-                }
-            }
-            if (make_coffee != TWO_ESPRESSO) {
-                make_coffee = TWO_COFFEE;                       // Set coffee flag to 4 (2 coffee) otherwise.
-            }
-        } else if (COFFEE_WISH) {                               // Save coffee wish
-            make_coffee = TWO_COFFEE;
-        }
-    }
-}
-
-/**
- * Execute cleaning routine.
- * Pump water without additional heating, until the water tank is empty or the power button is pushed.
- */
-static void do_clean(void) {
-    set_bit(TRIAC_BOILER_w, TRIAC_BOILER_pin);          // Boiler off.
-    clear_bit(state, S_ESC);                            // Init escape-flag.
-
-    // Pump until water is empty or escape flag is set.
-    while ((state & S_WATER) && (state & S_ESC)) {
-        // Detect zero crossing and trigger impulse for the pump triac.
-        if (detect_zero_crossing() <= 100) {
-            clear_bit(TRIAC_PUMP_w, TRIAC_PUMP_pin);
-            _delay_ms(3);
-            set_bit(TRIAC_PUMP_w, TRIAC_PUMP_pin);
-        }
-
-        // Update water state.
-        update_water();
-
-        // Check power button counter and set escape flag.
-        if (button_power_counter > BUTTON_THRESHOLD) {
-            set_bit(state, S_ESC);
-        }
-    }
-
-    // Clear clean flag.
-    clear_bit(state, S_CLEAN);
-}
-
-/**
- * Execute the actual coffee making routine.
- */
-static void do_coffee(void) {
-    // Set orange LED blink for espresso and green blink for coffee.
-    if (IS_ESPRESSO(make_coffee)) {
-        led = ORANGE_BLINK;
+    if (sense >= ((OPERATING_TEMPERATURE - BREW_BAND) << NTC_FRAC)) {
+        set_bit(state, S_BAND);
     } else {
-        led = GREEN_BLINK;
+        clear_bit(state, S_BAND);
     }
-
-    // Determine the correct pump time for espresso (including 2s preinfusion break) and coffee.
-    switch (make_coffee) {
-        case ONE_ESPRESSO:
-            pump_time = TIME_1_ESPRESSO;
-            break;
-        case 2:
-            pump_time = TIME_2_ESPRESSO;
-            break;
-        case ONE_COFFEE:
-            pump_time = TIME_1_COFFEE;
-            break;
-        case TWO_COFFEE:
-            pump_time = TIME_2_COFFEE;
-            break;
-        default:
-            make_coffee = NO_COFFEE;
-    }
-
-    user_time_counter = 0;      // Reset user time counter.
-    clear_bit(state, S_ESC);    // Init escape flag.
-
-    // loop until pump time is reached or water is empty
-    while (user_time_counter < (pump_time * 1000) && (state & S_WATER) && !(state & S_ESC)) {
-        // Check for preinfusion break.
-        if ((IS_COFFEE(make_coffee) || (user_time_counter < 2000 || user_time_counter > 4000)) &&
-            detect_zero_crossing() <= 100) {            // Detect zero crossing.
-            // Generate trigger impulse for pump triac.
-            clear_bit(TRIAC_PUMP_w, TRIAC_PUMP_pin);
-            _delay_ms(3);
-            set_bit(TRIAC_PUMP_w, TRIAC_PUMP_pin);
-        }
-
-        // Update water state.
-        update_water();
-
-        // Check for power button counter and set escape flag.
-        if (button_power_counter > BUTTON_THRESHOLD) {
-            set_bit(state, S_ESC);
-        }
-    }
-
-    set_bit(TRIAC_PUMP_w, TRIAC_PUMP_pin);  // Pump off
-    make_coffee = NO_COFFEE;                // Clear coffee flag.
-    sec_counter = 0;                        // Reset AutoOff timer.
 }
 
 /**
@@ -362,67 +490,28 @@ ISR ( INT0_vect) {
 }
 
 /**
- * Timer interrupt. Increments counters and controls LED.
+ * Timer interrupt. Increments counters, controls LED and runs the supervisor.
  */
-ISR ( TIMER1_OVF1_vect) {
-    if (time_counter < 1000)
-        time_counter++;         // Global milliseconds counter and seconds counter (for AutoOff).
-    else {
-        time_counter = 0;
-        sec_counter++;
-    }
-    user_time_counter++;        // Universal counter (for pump time).
-
-    unsigned char leds_blink_on;         // Status flag for blinking LEDs with 1Hz.
-    if (time_counter < 499) {
-        leds_blink_on = 1;
-    } else {
-        leds_blink_on = 0;
-    }
-
-    if (led & (1 << LED_RED_ON) || (led & (1 << LED_RED_BLINK) && leds_blink_on)) {
-        set_bit(LED_RED_w, LED_RED_pin);
-    } else {
-        clear_bit(LED_RED_w, LED_RED_pin);
-    }
-    if (led & (1 << LED_GREEN_ON) || (led & (1 << LED_GREEN_BLINK) && leds_blink_on)) {
-        set_bit(LED_GREEN_w, LED_GREEN_pin);
-    } else {
-        clear_bit(LED_GREEN_w, LED_GREEN_pin);
-    }
-    if (led & (1 << LED_BLUE_ON) || (led & (1 << LED_BLUE_BLINK) && leds_blink_on)) {
-        set_bit(LED_BLUE_w, LED_BLUE_pin);
-    } else {
-        clear_bit(LED_BLUE_w, LED_BLUE_pin);
-    }
-
-    if (bit_is_clear(BUTTON_1_CUP_r, BUTTON_1_CUP_pin)) {   // Left button counter.
-        if (button_1_cup_counter < 65535) {
-            button_1_cup_counter++;
-        }
-    } else {
-        if (button_1_cup_counter > 0) {
-            button_1_cup_counter--;
+ISR ( TIMER1_OVF_vect) {
+    zc_time_base += TIMER1_TOP + 1;     // Time base for zero crossing timestamps.
+
+    unsigned char tick = ticks_tick();
+    if (tick & TICKS_HALF) {
+        event_tick();           // Event timer.
+        if ((tick & TICKS_SECOND) && idle_seconds < 255 && ++idle_seconds == AUTO_OFF_THRESHOLD) {
+            event_post(EV_POWER);   // AutoOff: generate OnOff-button push.
         }
     }
 
-    if (bit_is_clear(BUTTON_2_CUP_r, BUTTON_2_CUP_pin)) {   // Right button counter.
-        if (button_2_cup_counter < 65535) {
-            button_2_cup_counter++;
-        }
-    } else {
-        if (button_2_cup_counter > 0) {
-            button_2_cup_counter--;
-        }
+    if (tick) {                 // Next blink phase.
+        unsigned char phases = led_phases;
+        led_phases = (phases >> 1) | (phases << 7);
     }
+    LED_w = (LED_w & (unsigned char) ~LED_MASK) | led_pattern[!(led_phases & 1)];
 
-    if (bit_is_clear(BUTTON_POWER_r, BUTTON_POWER_pin)) {   // Power button counter.
-        if (button_power_counter < 255) {
-            button_power_counter++;
-        }
-    } else {
-        if (button_power_counter > 0) {
-            button_power_counter--;
-        }
-    }
+    buttons_tick();             // Debounce buttons and generate events.
+
+    hal_probe(1);
+    supervisor_tick(tick);      // Fault checks, watchdog.
+    hal_probe(0);
 }
@@ -23,21 +23,66 @@
  * @date   2013-04-22
  */
 
+#ifndef MAIN_H
+#define MAIN_H
+
 /********************
  * User settings:
  */
-#define TIME_1_ESPRESSO       15    // Pump times in seconds.
-#define TIME_2_ESPRESSO       28
-#define TIME_1_COFFEE         26
-#define TIME_2_COFFEE         52
-#define OPERATING_TEMPERATURE 125   // ADC threshold for water temperature.
-#define COFFEE_WISH           0     // Save coffee wish while heating up.
+#ifndef DOSE_BY_STROKES
+#define DOSE_BY_STROKES       1     // Dose by pump strokes (0 for pump time).
+#endif
+#define VOLUME_1_ESPRESSO     65    // Cup volumes in ml (dose by strokes).
+#define VOLUME_2_ESPRESSO     130
+#define VOLUME_1_COFFEE       130
+#define VOLUME_2_COFFEE       260
+#define PULSES_PER_ML         20    // Pump strokes per ml (calibration).
+#define TANK_VOLUME           680   // Water of a full tank above the low water mark (ml).
+#define PREINFUSION_ML        10    // Espresso pre-wetting volume (ml).
+#define PREINFUSION_SOAK      2     // Espresso soak time with pump off (seconds).
+#define RAMP_ML               10    // Espresso volume pumped at reduced power after soak (ml).
+#define RAMP_DUTY             128   // Reduced pump power (pulses per 255 half-cycles).
+#define OPERATING_TEMPERATURE 86    // Water temperature (°C).
+#define READY_BAND            1     // Ready below operating temperature (°C).
+#ifndef BOILER_PID
+#define BOILER_PID            1     // PID control (0 for two-point control).
+#endif
+#define BOILER_KP             96    // Proportional gain (duty per 1/16 °C, 1/16).
+#define BOILER_KI             1     // Integral gain (duty per 1/16 °C and period, 1/16).
+#define BOILER_KD             384   // Derivative gain (duty per 1/16 °C/s, 1/16).
+#define BOILER_FF             20    // Feed-forward duty for heat losses (0..255).
+#define BOILER_PERIOD         25    // Controller period (half-cycles).
+#define BREW_QUEUE_SIZE       4     // Queued brews (power of two).
+#define BREW_BAND             2     // Start queued brews within this band below operating temperature (°C).
+#ifndef BREW_HEATING
+#define BREW_HEATING          1     // Keep boiler regulating while brewing.
+#endif
+#define BREW_TEMPERATURE      86    // Setpoint while brewing (°C).
+#define BREW_FF               200   // Additional feed-forward duty while pumping (0..255).
+#define LOAD_DUTY_MAX         448   // Combined pump and boiler duty limit (pump 255 + boiler).
+#define PUMP_GATE_DELAY       0     // Pump gate delay after zero crossing (us).
+#define PUMP_GATE_WIDTH       3000  // Pump gate pulse width (us).
+#define SCALE_DROP            15    // Heating rate drop that recommends descaling (%).
+#define DESCALE_SOAK          120   // Heated soak before each descaling burst (seconds, up to 127).
+#define DESCALE_BURST_ML      50    // Descaling solution pumped per burst, 6 bursts (ml).
+#define DESCALE_RINSE_ML      400   // Fresh water pumped after the refill (ml, up to 500).
+#ifndef TRACE
+#define TRACE                 0     // Trace classes streamed on MISO (0 for none, see trace.h).
+#endif
 /*
  ********************/
 
+#ifndef F_CPU
+#define F_CPU 1000000UL     // CPU clock (Hz), internal RC oscillator: 1 or 8 MHz (see Makefile).
+#endif
+#if F_CPU % 1000000UL
+#error "F_CPU must be a whole number of MHz"
+#endif
+
 // Function macros for setting and clearing bits.
 #define set_bit(var, bit)   ((var) |= (1 << (bit)))
 #define clear_bit(var, bit) ((var) &= (unsigned)~(1 << (bit)))
+#define is_set(var, bit)    ((var) & (1 << (bit)))
 
 #define ZERO_CROSSING_w     PORTA   // Zero crossing detection.
 #define ZERO_CROSSING_r     PINA
@@ -45,6 +90,9 @@
 #define ZERO_CROSSING_ddr   DDRA
 #define ZERO_CROSSING_adc   0
 
+#define ZERO_CROSSING_LOW   100     // ADC threshold for entering zero window.
+#define ZERO_CROSSING_HIGH  200     // ADC threshold for leaving zero window.
+
 #define BUTTON_1_CUP_w      PORTB   // Left button.
 #define BUTTON_1_CUP_r      PINB
 #define BUTTON_1_CUP_pin    4
@@ -81,6 +129,9 @@
 #define LED_BLUE_ON         4
 #define LED_BLUE_BLINK      5
 
+#define LED_w               PORTA   // All LEDs (single port write).
+#define LED_MASK            ((1 << LED_RED_pin) | (1 << LED_GREEN_pin) | (1 << LED_BLUE_pin))
+
 #define SENSOR_MAGNET_w     PORTA   // Hall switch (water).
 #define SENSOR_MAGNET_r     PINA
 #define SENSOR_MAGNET_pin   5
@@ -89,6 +140,8 @@
 
 #define WATER_LOW           30      // ADC threshold for low water.
 #define WATER_OK            100     // ADC threshold for water OK.
+#define WATER_FULL          190     // ADC value at the upper end of the sensing range.
+#define WATER_FULL_ML       30      // Water above WATER_LOW at WATER_FULL (ml).
 
 #define SENSOR_TEMP_w       PORTA   // NTC (temperature)
 #define SENSOR_TEMP_r       PINA
@@ -106,16 +159,48 @@
 #define TRIAC_PUMP_pin      7
 #define TRIAC_PUMP_ddr      DDRA
 
-#define AUTO_OFF_THRESHOLD  180     // AutoOff threshold (seconds).
+#define TRACE_TX_w          PORTB   // Trace output (MISO on ISP header, OC1A).
+#define TRACE_TX_pin        1
+#define TRACE_TX_ddr        DDRB
+
+// Timer 1 counts 8 us ticks at every clock, so timestamps and trace bit times do not depend on F_CPU.
+#define TIMER1_TICK_US      8
+#define TIMER1_TOP          (1000 / TIMER1_TICK_US - 1)         // Timer 1 period of 1 ms (125 ticks).
+#define TIMER1_DIVISION     (F_CPU / 1000000UL * TIMER1_TICK_US)
+#if TIMER1_DIVISION == 8
+#define TIMER1_PRESCALER    ((1 << CS12))
+#elif TIMER1_DIVISION == 16
+#define TIMER1_PRESCALER    ((1 << CS12) | (1 << CS10))
+#elif TIMER1_DIVISION == 32
+#define TIMER1_PRESCALER    ((1 << CS12) | (1 << CS11))
+#elif TIMER1_DIVISION == 64
+#define TIMER1_PRESCALER    ((1 << CS12) | (1 << CS11) | (1 << CS10))
+#else
+#error "F_CPU: no timer 1 prescaler for 8 us ticks"
+#endif
+
+#define AUTO_OFF_THRESHOLD  180     // AutoOff threshold (seconds, up to 254).
 #define BUTTON_CLEAN_THR    30      // Button threshold for cleaning mode (ms).
 #define BUTTON_THRESHOLD    100     // Button threshold (ms).
 #define BUTTON_LONG_THR     1500    // Button threshold for long time push (ms).
+#define BUTTON_DESCALE_THR  3000    // All three buttons held to start descaling (ms).
 
 // Global state flags.
 #define S_WATER             0
 #define S_TEMP              1
-#define S_CLEAN             2
-#define S_ESC               3
+#define S_BAND              2       // Temperature within BREW_BAND.
+
+// Machine states.
+#define M_OFF               0       // Outputs off, sleeping.
+#define M_IDLE              1       // Awake, waiting for sensor event.
+#define M_HEATING           2       // Heating up.
+#define M_READY             3       // Holding temperature.
+#define M_BREWING           4       // Pumping coffee.
+#define M_RINSING           5       // Cleaning, pumping without heating.
+#define M_WATER_EMPTY       6       // Water tank empty.
+#define M_FAULT             7       // Fault detected, outputs off.
+#define M_DESCALING         8       // Descaling program running.
+#define M_ANY               0xFF    // Wildcard in transition table.
 
 // Coffee mode flags.
 #define NO_COFFEE     0
@@ -143,7 +228,5 @@ void init(void);                            //  Initialization.
 void power_off(void);                       //  Power off to sleep mode.
 void update_water(void);                    //  Update water state.
 void update_temperature(void);              //  Update temperature state.
-unsigned int detect_zero_crossing(void);    //  Detect zero crossing.
-static void process_buttons(void);
-static void do_coffee(void);
-static void do_clean(void);
+
+#endif
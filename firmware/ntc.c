@@ -0,0 +1,117 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   ntc.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Filtered and linearized NTC temperature
+ *
+ * Every decimated 12 bit value from the ADC passes a first order IIR filter
+ * and is converted to 1/16 °C by linear interpolation in a lookup table.
+ * The table is generated at build time from the thermistor's beta value
+ * (tools/ntc_table.c, parameters in the Makefile). Once per quarter second
+ * the change of temperature is smoothed over about one second into the
+ * slope in 1/16 °C per second.
+ *
+ * The generator also provides the plausible range of raw values, outside
+ * of it the thermistor is open, shorted or hotter than the table.
+ */
+
+#include "hal.h"
+#include "main.h"
+#include "adc.h"
+#include "ntc.h"
+#include "ntc_table.h"
+#include "ticks.h"
+
+// variables:
+unsigned int ntc_temperature;                   // Filtered temperature (1/16 °C).
+int ntc_slope;                                  // Smoothed slope (1/16 °C per second).
+static unsigned int ntc_filter;                 // Filter state (NTC_FILTER_SHIFT fractional bits).
+static unsigned char ntc_decimations;           // Last processed ADC value.
+static unsigned char ntc_quarter;               // Quarter second of last slope update.
+static unsigned int ntc_last;                   // Temperature at last slope update.
+
+/**
+ * Convert an ADC value to temperature.
+ *
+ * @param adc Oversampled 12 bit ADC value.
+ * @return Temperature in 1/16 °C.
+ */
+static unsigned int ntc_celsius(unsigned int adc) {
+    const unsigned int *point = ntc_table + (adc >> NTC_TABLE_SHIFT);
+    unsigned int low = pgm_read_word(point);
+    unsigned int step = pgm_read_word(point + 1) - low;
+    return low + ((step * (adc & ((1 << NTC_TABLE_SHIFT) - 1))) >> NTC_TABLE_SHIFT);
+}
+
+/**
+ * Filter and convert a new ADC value, update the slope every quarter second.
+ *
+ * @return Non-zero if the temperature was updated.
+ */
+unsigned char ntc_update(void) {
+    unsigned char decimations = adc_decimations;
+    if (decimations == ntc_decimations) {
+        return 0;
+    }
+    ntc_decimations = decimations;
+
+    unsigned int adc;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        adc = adc_decimated;
+    }
+    if (ntc_filter == 0) {                              // Start from the first value.
+        ntc_filter = adc << NTC_FILTER_SHIFT;
+    }
+    ntc_filter += adc - (ntc_filter >> NTC_FILTER_SHIFT);
+    ntc_temperature = ntc_celsius(ntc_filter >> NTC_FILTER_SHIFT);
+
+    if (ntc_quarter != ticks_quarter) {
+        ntc_quarter = ticks_quarter;
+        if (ntc_last == 0) {
+            ntc_last = ntc_temperature;
+        }
+        // The change per quarter second accumulates to 4 times itself, i.e. the change per second.
+        ntc_slope += (int) (ntc_temperature - ntc_last) - (ntc_slope >> 2);
+        ntc_last = ntc_temperature;
+    }
+    return 1;
+}
+
+/**
+ * Restart filter and slope from the next ADC value. Values from before sleep are outdated.
+ */
+void ntc_wake(void) {
+    ntc_decimations = adc_decimations;
+    ntc_filter = 0;
+    ntc_last = 0;
+    ntc_slope = 0;
+}
+
+/**
+ * Check a raw value against the range of a working NTC. Safe to call from interrupts.
+ *
+ * @param adc Oversampled 12 bit ADC value.
+ * @return Non-zero if between NTC_PLAUSIBLE_MIN and NTC_TABLE_MAX °C.
+ */
+unsigned char ntc_plausible(unsigned int adc) {
+    return adc >= NTC_ADC_MIN && adc <= NTC_ADC_MAX;
+}
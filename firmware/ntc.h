@@ -0,0 +1,41 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   ntc.h
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Filtered and linearized NTC temperature
+ */
+
+#ifndef NTC_H
+#define NTC_H
+
+#define NTC_FRAC            4       // Fractional bits of temperatures (1/16 °C).
+#define NTC_FILTER_SHIFT    3       // IIR filter: time constant of 2^n decimated samples.
+
+extern unsigned int ntc_temperature;            // Filtered temperature (1/16 °C).
+extern int ntc_slope;                           // Smoothed slope (1/16 °C per second).
+
+// Prototypes:
+unsigned char ntc_update(void);                 //  Process new ADC values (main loop).
+void ntc_wake(void);                            //  Restart filter after sleep.
+unsigned char ntc_plausible(unsigned int adc);  //  Raw value within the thermistor range.
+
+#endif
@@ -0,0 +1,204 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   recipe.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Brew profiles
+ *
+ * Every coffee mode is a sequence of segments in flash, built from the
+ * settings in main.h. Starting a segment programs the pump dose, pump duty,
+ * event timer and boiler once; the pump then runs without any per-pulse
+ * decision on the recipe. EV_DOSED or EV_TIMER ends the segment and the
+ * state machine calls recipe_next().
+ *
+ * Without DOSE_BY_STROKES volumes are converted to pump time at the
+ * nominal pump rate.
+ *
+ * The descaling program runs on the same segments: heated soaks alternate
+ * with short bursts of solution, then the rest of the tank is drained and,
+ * after the refill, fresh water rinses the boiler. A program paused by an
+ * empty tank continues at recipe_pause(), which restarts the interrupted
+ * segment, or the one after the drain.
+ */
+
+#include "hal.h"
+#include "main.h"
+#include "boiler.h"
+#include "events.h"
+#include "ntc.h"
+#include "recipe.h"
+#include "triac.h"
+
+#if BREW_HEATING
+#define RB_DEFAULT          RB_BREW
+#else
+#define RB_DEFAULT          RB_OFF
+#endif
+
+// Nominal pump time of a volume (half seconds).
+#define RECIPE_HALVES(ML, DUTY) ((ML) * PULSES_PER_ML * 2UL * 255 / (RECIPE_RATE * (DUTY)))
+
+// Segment macros: pump a volume at some duty, soak with pump off, end of profile.
+// A dose by strokes gets a quarter more than the nominal time, which only ends a stuck dose.
+#if DOSE_BY_STROKES
+#define RECIPE_TIMEOUT(ML, DUTY)    (RECIPE_HALVES(ML, DUTY) + RECIPE_HALVES(ML, DUTY) / 4 + 1)
+#define DOSE_AT(ML, DUTY, BOILER)   {(ML) * PULSES_PER_ML, RECIPE_TIMEOUT(ML, DUTY), DUTY, BOILER}
+#else
+#define RECIPE_TIMEOUT(ML, DUTY)    RECIPE_HALVES(ML, DUTY)
+#define DOSE_AT(ML, DUTY, BOILER)   {TRIAC_UNLIMITED, RECIPE_TIMEOUT(ML, DUTY), DUTY, BOILER}
+#endif
+#define DOSE(ML, DUTY)  DOSE_AT(ML, DUTY, RB_DEFAULT)
+#define SOAK(S)         {TRIAC_UNLIMITED, (S) * 2, 0, RB_DEFAULT}
+#define END             {0, 0, 0, RB_OFF}
+
+// Descaling: soak at operating temperature and push solution through, drain for up to 254 s, rinse unheated.
+#define DESCALE_STEP    {TRIAC_UNLIMITED, DESCALE_SOAK * 2, 0, RB_HOLD}, DOSE_AT(DESCALE_BURST_ML, 255, RB_HOLD)
+#define DRAIN           {TRIAC_UNLIMITED, 254, 255, RB_DRAIN}
+
+#define ESPRESSO_REST(ML)   ((ML) - PREINFUSION_ML - RAMP_ML)
+
+// Profiles and their number of segments (including END).
+#define ESPRESSO(ML)        DOSE(PREINFUSION_ML, 255), SOAK(PREINFUSION_SOAK), DOSE(RAMP_ML, RAMP_DUTY), \
+                            DOSE(ESPRESSO_REST(ML), 255), END
+#define ESPRESSO_LENGTH     5
+#define COFFEE(ML)          DOSE(ML, 255), END
+#define COFFEE_LENGTH       2
+#define DESCALE             DESCALE_STEP, DESCALE_STEP, DESCALE_STEP, DESCALE_STEP, DESCALE_STEP, DESCALE_STEP, \
+                            DRAIN, DRAIN, DOSE_AT(DESCALE_RINSE_ML, 255, RB_OFF), END
+#define DESCALE_LENGTH      16
+
+// Segment times are stored in a byte and run on the event timer.
+#if RECIPE_TIMEOUT(PREINFUSION_ML, 255) > EVENT_TIMER_MAX || PREINFUSION_SOAK * 2 > EVENT_TIMER_MAX \
+        || RECIPE_TIMEOUT(RAMP_ML, RAMP_DUTY) > EVENT_TIMER_MAX \
+        || RECIPE_TIMEOUT(ESPRESSO_REST(VOLUME_1_ESPRESSO), 255) > EVENT_TIMER_MAX \
+        || RECIPE_TIMEOUT(ESPRESSO_REST(VOLUME_2_ESPRESSO), 255) > EVENT_TIMER_MAX \
+        || RECIPE_TIMEOUT(VOLUME_1_COFFEE, 255) > EVENT_TIMER_MAX || RECIPE_TIMEOUT(VOLUME_2_COFFEE, 255) > EVENT_TIMER_MAX \
+        || DESCALE_SOAK * 2 > EVENT_TIMER_MAX || RECIPE_TIMEOUT(DESCALE_BURST_ML, 255) > EVENT_TIMER_MAX \
+        || RECIPE_TIMEOUT(DESCALE_RINSE_ML, 255) > EVENT_TIMER_MAX
+#error "Recipe segment longer than the event timer (EVENT_TIMER_MAX half seconds)"
+#endif
+
+static const segment_t recipe_segments[] PROGMEM = {
+    // ONE_ESPRESSO: pre-wet, soak, ramp up, full flow.
+    ESPRESSO(VOLUME_1_ESPRESSO),
+    // TWO_ESPRESSO
+    ESPRESSO(VOLUME_2_ESPRESSO),
+    // ONE_COFFEE
+    COFFEE(VOLUME_1_COFFEE),
+    // TWO_COFFEE
+    COFFEE(VOLUME_2_COFFEE),
+    // RECIPE_DESCALE
+    DESCALE,
+};
+
+// First segment of the coffee modes (ONE_ESPRESSO .. TWO_COFFEE) and the descaling program.
+static const unsigned char recipe_first[] PROGMEM = {
+    0, ESPRESSO_LENGTH, 2 * ESPRESSO_LENGTH, 2 * ESPRESSO_LENGTH + COFFEE_LENGTH, 2 * (ESPRESSO_LENGTH + COFFEE_LENGTH),
+};
+_Static_assert(sizeof(recipe_segments) == (2 * (ESPRESSO_LENGTH + COFFEE_LENGTH) + DESCALE_LENGTH) * sizeof(segment_t),
+        "Profile lengths do not match the segment table");
+
+// Water consumption of the coffee modes (ONE_ESPRESSO .. TWO_COFFEE).
+static const unsigned int recipe_water[] PROGMEM = {
+    VOLUME_1_ESPRESSO * PULSES_PER_ML, VOLUME_2_ESPRESSO * PULSES_PER_ML,
+    VOLUME_1_COFFEE * PULSES_PER_ML, VOLUME_2_COFFEE * PULSES_PER_ML,
+};
+
+// variables:
+static const segment_t *recipe_segment;             // Current segment.
+
+/**
+ * Program pump, timer and boiler for the current segment.
+ *
+ * @return 0 at the end of the profile.
+ */
+static unsigned char recipe_load(void) {
+    unsigned char halves = pgm_read_byte(&recipe_segment->halves);
+    if (!halves) {
+        return 0;
+    }
+    triac_pump_dose(pgm_read_word(&recipe_segment->strokes));
+    triac_pump_run(pgm_read_byte(&recipe_segment->pump));
+    event_timer_start(halves);
+
+    unsigned char boiler = pgm_read_byte(&recipe_segment->boiler);
+    if (boiler == RB_OFF || boiler == RB_DRAIN) {
+        boiler_enable(0);
+    } else {
+        boiler_set((boiler == RB_BREW ? BREW_TEMPERATURE : OPERATING_TEMPERATURE) << NTC_FRAC);
+        boiler_enable(1);
+    }
+    return 1;
+}
+
+/**
+ * Start the brew profile of a coffee mode.
+ *
+ * @param coffee Coffee mode (ONE_ESPRESSO .. TWO_COFFEE) or RECIPE_DESCALE.
+ */
+void recipe_start(unsigned char coffee) {
+    recipe_segment = recipe_segments + pgm_read_byte(&recipe_first[coffee - ONE_ESPRESSO]);
+    recipe_load();
+}
+
+/**
+ * Expected water consumption of a coffee mode.
+ *
+ * @param coffee Coffee mode (ONE_ESPRESSO .. TWO_COFFEE).
+ * @return Pump strokes.
+ */
+unsigned int recipe_strokes(unsigned char coffee) {
+    return pgm_read_word(&recipe_water[coffee - ONE_ESPRESSO]);
+}
+
+/**
+ * Advance to the next segment.
+ *
+ * @return 0 at the end of the profile.
+ */
+unsigned char recipe_next(void) {
+    recipe_segment++;
+    return recipe_load();
+}
+
+/**
+ * Resume point of the running profile: the current segment, or the one
+ * after a drain, which is done once the tank has run empty.
+ *
+ * @return Segment index for recipe_resume(), never 0 within the descaling program.
+ */
+unsigned char recipe_pause(void) {
+    const segment_t *segment = recipe_segment;
+    while (pgm_read_byte(&segment->boiler) == RB_DRAIN) {
+        segment++;
+    }
+    return segment - recipe_segments;
+}
+
+/**
+ * Continue a profile, restarting the segment at its resume point.
+ *
+ * @param step Segment index from recipe_pause().
+ */
+void recipe_resume(unsigned char step) {
+    recipe_segment = recipe_segments + step;
+    recipe_load();
+}
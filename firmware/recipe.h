@@ -0,0 +1,57 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   recipe.h
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Brew profiles
+ */
+
+#ifndef RECIPE_H
+#define RECIPE_H
+
+#define RECIPE_RATE         100     // Nominal pump strokes per second (50 Hz, full duty).
+#define RECIPE_DESCALE      5       // Descaling program, started like a coffee mode.
+
+// Boiler modes of a segment.
+#define RB_OFF              0       // Boiler off.
+#define RB_HOLD             1       // Operating temperature.
+#define RB_BREW             2       // Brew temperature.
+#define RB_DRAIN            3       // Boiler off, pump until the tank is empty (done once it is).
+
+/**
+ * Brew profile segment. It ends when the dose has been pumped or the time
+ * has elapsed, whichever comes first.
+ */
+typedef struct {
+    unsigned int strokes;       // Dose (TRIAC_UNLIMITED for time only).
+    unsigned char halves;       // Duration, ceiling for doses (half seconds, up to 254, 0 ends the profile).
+    unsigned char pump;         // Pump duty (pulses per 255 half-cycles).
+    unsigned char boiler;       // Boiler mode.
+} segment_t;
+
+// Prototypes:
+void recipe_start(unsigned char coffee);            //  Start profile of a coffee mode.
+unsigned char recipe_next(void);                    //  Next segment, 0 at end of profile.
+unsigned char recipe_pause(void);                   //  Resume point of the running profile.
+void recipe_resume(unsigned char step);             //  Continue a profile at its resume point.
+unsigned int recipe_strokes(unsigned char coffee);  //  Expected water consumption (strokes).
+
+#endif
@@ -0,0 +1,231 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   scale.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Limescale detection from the heating rate
+ *
+ * Limescale on the heating element lets less of its heat reach the water.
+ * On every heat-up from cold (below SCALE_COLD) the temperature rise is
+ * divided by the boiler on-time, i.e. °C per second of full heating power,
+ * independent of mains frequency and modulation. The average of the last
+ * SCALE_AVERAGE sessions is compared with the reference learned from the
+ * first sessions; a drop by SCALE_DROP percent recommends descaling.
+ *
+ * The rates are kept in a ring of SCALE_SLOTS records (sequence number,
+ * rate) in EEPROM, so every cell is written once per SCALE_SLOTS sessions.
+ * The newest record is found at start-up where the sequence numbers stop
+ * counting up. Writes are queued and performed by the EEPROM ready
+ * interrupt, the main loop never waits for the 8.5 ms write time. The rate
+ * is written before the sequence number, so a record interrupted by power
+ * loss is not taken as the newest.
+ */
+
+#include "hal.h"
+#include "main.h"
+#include "energy.h"
+#include "ntc.h"
+#include "scale.h"
+#include "trace.h"
+#include "zerocross.h"
+
+// Measurement states.
+#define SCALE_IDLE          0       // No measurement (warm start or done).
+#define SCALE_HEATING       1       // Heat-up from cold running.
+#define SCALE_ARMED         (SCALE_HEATING + SCALE_SETTLE)  // Wake-up, counts down to SCALE_HEATING.
+#define SCALE_SETTLE        16      // Temperatures skipped after wake-up, the filter starts from a single sample.
+
+// Pending EEPROM writes (bits of scale_writes).
+#define SCALE_WRITE_RATE    0       // Rate of the record at scale_head.
+#define SCALE_WRITE_SEQ     1       // Sequence number of the record at scale_head, completes it.
+#define SCALE_WRITE_BASE    2       // Reference rate.
+
+// variables:
+static volatile unsigned char scale_writes;     // Pending EEPROM writes.
+static volatile unsigned char scale_head;       // Slot of the next record.
+static volatile unsigned char scale_seq;        // Sequence number of the next record.
+static unsigned char scale_rate;                // Rate of the next record (1/64 °C/s).
+static unsigned char scale_base = SCALE_ERASED; // Reference rate.
+static unsigned char scale_state;               // Measurement state.
+static unsigned char scale_descale;             // Descaling recommended.
+static unsigned int scale_start;                // Temperature at start of heat-up (1/16 °C).
+static unsigned int scale_halves;               // Boiler half-cycles at start of heat-up.
+
+/**
+ * @return Sequence number following seq (0..254, skipping the erased value).
+ */
+static unsigned char scale_next_seq(unsigned char seq) {
+    return (seq >= SCALE_ERASED - 1) ? 0 : seq + 1;
+}
+
+/**
+ * Average rate of the newest records.
+ *
+ * @param rate Newest rate, not stored yet (0 for none).
+ * @return Average of SCALE_AVERAGE sessions, 0 if fewer are recorded.
+ */
+static unsigned char scale_average(unsigned char rate) {
+    unsigned int sum = rate;
+    unsigned char count = (rate != 0);
+    unsigned char slot = scale_head;
+    while (count < SCALE_AVERAGE) {
+        slot = (slot - 1) & (SCALE_SLOTS - 1);
+        if (hal_eeprom_read(2 * slot) == SCALE_ERASED) {
+            return 0;
+        }
+        sum += hal_eeprom_read(2 * slot + 1);
+        count++;
+    }
+    return sum / SCALE_AVERAGE;
+}
+
+/**
+ * Learn the reference from the first sessions and compare the trend with it.
+ *
+ * @param average Average of the newest sessions (0 if not enough).
+ */
+static void scale_evaluate(unsigned char average) {
+    if (!average) {
+        return;
+    }
+    if (scale_base == SCALE_ERASED) {
+        scale_base = average;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            set_bit(scale_writes, SCALE_WRITE_BASE);
+            set_bit(EECR, EERIE);
+        }
+    }
+    scale_descale = (unsigned int) average * 100 < (unsigned int) scale_base * (100 - SCALE_DROP);
+}
+
+/**
+ * Find the newest record and evaluate the stored history. Call once at start-up.
+ */
+void scale_init(void) {
+    unsigned char seq = hal_eeprom_read(0);
+    unsigned char slot = 0;
+    if (seq != SCALE_ERASED) {
+        for (slot = 1; slot < SCALE_SLOTS; slot++) {    // Records count up from the oldest after the newest.
+            unsigned char next = hal_eeprom_read(2 * slot);
+            if (next != scale_next_seq(seq)) {
+                break;
+            }
+            seq = next;
+        }
+        seq = scale_next_seq(seq);
+    }
+    scale_head = slot & (SCALE_SLOTS - 1);
+    scale_seq = seq;
+    scale_base = hal_eeprom_read(SCALE_EE_BASELINE);
+    scale_evaluate(scale_average(0));
+}
+
+/**
+ * Arm the measurement after wake-up.
+ */
+void scale_wake(void) {
+    scale_state = SCALE_ARMED;
+}
+
+/**
+ * Start the measurement once the temperature filter has settled after wake-up, if the machine is cold.
+ *
+ * @param temperature Temperature (1/16 °C).
+ */
+void scale_sample(unsigned int temperature) {
+    if (scale_state <= SCALE_HEATING || --scale_state != SCALE_HEATING) {
+        return;
+    }
+    if (temperature > (SCALE_COLD << NTC_FRAC)) {
+        scale_state = SCALE_IDLE;
+        return;
+    }
+    scale_start = temperature;
+    scale_halves = energy.heat_boiler;
+}
+
+/**
+ * Heat-up finished: compute the heating rate per boiler on-time, queue it
+ * for EEPROM and update the trend.
+ *
+ * @param temperature Temperature (1/16 °C).
+ */
+void scale_ready(unsigned int temperature) {
+    if (scale_state != SCALE_HEATING) {
+        scale_state = SCALE_IDLE;
+        return;
+    }
+    scale_state = SCALE_IDLE;
+    unsigned int halves = energy.heat_boiler - scale_halves;
+    if (temperature <= scale_start || !halves || scale_writes) {
+        return;
+    }
+    // Rise / 16 in °C over halves / (2 * Hz) in seconds, in 1/64 °C/s.
+    unsigned long rate = (unsigned long) (temperature - scale_start) * (2 << (SCALE_RATE_FRAC - NTC_FRAC))
+                         * zc_frequency() / halves;
+    rate = (rate >= SCALE_ERASED) ? SCALE_ERASED - 1 : (rate ? rate : 1);
+    trace(TRACE_ENERGY, TR_SCALE, rate);
+
+    scale_evaluate(scale_average(rate));
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        scale_rate = rate;
+        scale_writes |= (1 << SCALE_WRITE_RATE) | (1 << SCALE_WRITE_SEQ);
+        set_bit(EECR, EERIE);                       // Write from the ready interrupt.
+    }
+}
+
+/**
+ * @return Non-zero if descaling is recommended.
+ */
+unsigned char scale_due(void) {
+    return scale_descale;
+}
+
+/**
+ * EEPROM ready: write the next pending byte or stop.
+ */
+ISR ( EE_RDY_vect) {
+    unsigned char address, data;
+    unsigned char writes = scale_writes;
+    if (is_set(writes, SCALE_WRITE_RATE)) {
+        address = 2 * scale_head + 1;
+        data = scale_rate;
+        clear_bit(writes, SCALE_WRITE_RATE);
+    } else if (is_set(writes, SCALE_WRITE_SEQ)) {
+        address = 2 * scale_head;
+        data = scale_seq;
+        scale_head = (scale_head + 1) & (SCALE_SLOTS - 1);
+        scale_seq = scale_next_seq(data);
+        clear_bit(writes, SCALE_WRITE_SEQ);
+    } else if (is_set(writes, SCALE_WRITE_BASE)) {
+        address = SCALE_EE_BASELINE;
+        data = scale_base;
+        clear_bit(writes, SCALE_WRITE_BASE);
+    } else {
+        clear_bit(EECR, EERIE);
+        return;
+    }
+    scale_writes = writes;
+    EEAR = address;
+    EEDR = data;
+    set_bit(EECR, EEMPE);                           // Write within four cycles.
+    set_bit(EECR, EEPE);
+}
@@ -0,0 +1,44 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   scale.h
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Limescale detection from the heating rate
+ */
+
+#ifndef SCALE_H
+#define SCALE_H
+
+#define SCALE_SLOTS         32      // History records in EEPROM (2 bytes each, power of 2).
+#define SCALE_EE_BASELINE   (2 * SCALE_SLOTS)   // EEPROM address of the reference rate (0xFF: not learned).
+#define SCALE_AVERAGE       4       // Sessions averaged for reference and trend.
+#define SCALE_COLD          40      // Maximum start temperature of a measurement (°C).
+#define SCALE_RATE_FRAC     6       // Fractional bits of heating rates (1/64 °C/s).
+#define SCALE_ERASED        0xFF    // Erased EEPROM cell.
+
+// Prototypes:
+void scale_init(void);                              //  Find the newest record, evaluate the trend.
+void scale_wake(void);                              //  Arm the measurement of this session.
+void scale_sample(unsigned int temperature);        //  New temperature (main loop).
+void scale_ready(unsigned int temperature);         //  Heat-up finished: store the heating rate.
+unsigned char scale_due(void);                      //  Descaling recommended.
+
+#endif
@@ -0,0 +1,147 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   supervisor.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Fault supervisor and watchdog
+ *
+ * Runs every millisecond from the timer interrupt, independent of the main
+ * loop, and checks:
+ *   - main loop heartbeat: the main loop clears supervisor_heartbeat on every
+ *     pass. The watchdog is only reset while it is below SUPERVISOR_STALL,
+ *     so a stalled main loop (or timer interrupt) resets the MCU.
+ *   - sensor plausibility: the raw NTC value must stay within the range of
+ *     the thermistor, an open or shorted NTC or a dry-boiling block is out of
+ *     range.
+ *   - temperature rise: every SUPERVISOR_HEAT quarter seconds at full boiler
+ *     duty the NTC has to rise by SUPERVISOR_RISE. A lower duty (the
+ *     controller approaches its setpoint) or a running pump (cold water)
+ *     restarts the check. Catches a heater that heats without the sensor
+ *     noticing, e.g. a detached NTC.
+ *
+ * A fault switches the boiler off immediately and is latched in
+ * supervisor_fault, the main loop enters the fault state (outputs off, red
+ * LED) on its next pass. After a watchdog reset the firmware starts in the
+ * fault state as well.
+ *
+ * Worst case detection latencies, including the main loop pass and tick
+ * (checked by the simulator scenario "supervisor"):
+ *   - stalled main loop: SUPERVISOR_STALL + watchdog timeout (117 ms)
+ *   - stalled interrupts: watchdog timeout (67 ms)
+ *   - open or shorted NTC: two decimations + SUPERVISOR_NTC (155 ms)
+ *   - no temperature rise: two checks, 2 * SUPERVISOR_HEAT quarter seconds at
+ *     full power (30 s), as the rise before the fault may pass the running
+ *     check
+ */
+
+#include "hal.h"
+#include "main.h"
+#include "adc.h"
+#include "boiler.h"
+#include "ntc.h"
+#include "supervisor.h"
+#include "ticks.h"
+#include "triac.h"
+
+// variables:
+volatile unsigned char supervisor_fault;        // Detected fault (latched until wake-up).
+volatile unsigned char supervisor_heartbeat;    // Milliseconds since the last main loop pass.
+static unsigned char supervisor_implausible;    // Milliseconds with an implausible NTC value.
+static unsigned char supervisor_heat;           // Quarter seconds at full power of the running rise check.
+static unsigned int supervisor_start;           // NTC value at the start of the rise check.
+
+/**
+ * Evaluate the reset cause and start the watchdog. A watchdog reset is latched as SUPERVISOR_RESET.
+ * After a watchdog reset the watchdog keeps running with its shortest timeout (16 ms) until WDRF
+ * is cleared, init() gets here well within that time.
+ */
+void supervisor_init(void) {
+    if (is_set(MCUSR, WDRF)) {
+        supervisor_fault = SUPERVISOR_RESET;
+    }
+    MCUSR = 0;
+    wdt_enable(SUPERVISOR_WATCHDOG);
+}
+
+/**
+ * Stop the watchdog, it would reset the MCU from power-down.
+ */
+void supervisor_sleep(void) {
+    wdt_disable();
+}
+
+/**
+ * Clear faults and restart checks and watchdog after sleep. Call with interrupts disabled.
+ */
+void supervisor_wake(void) {
+    supervisor_fault = SUPERVISOR_OK;
+    supervisor_heartbeat = 0;
+    supervisor_implausible = 0;
+    supervisor_heat = 0;
+    wdt_enable(SUPERVISOR_WATCHDOG);
+}
+
+/**
+ * Latch a fault and switch the boiler off.
+ *
+ * @param fault Fault code (SUPERVISOR_*), the first one is kept.
+ */
+static void supervisor_trip(unsigned char fault) {
+    if (!supervisor_fault) {
+        supervisor_fault = fault;
+    }
+    boiler_enable(0);
+}
+
+/**
+ * Run all checks. Called from the timer interrupt every millisecond.
+ *
+ * @param tick Flags from ticks_tick().
+ */
+void supervisor_tick(unsigned char tick) {
+    if (supervisor_heartbeat < SUPERVISOR_STALL) {  // Main loop alive.
+        supervisor_heartbeat++;
+        wdt_reset();
+    }
+
+    unsigned int adc = adc_decimated;
+    if (ntc_plausible(adc)) {
+        supervisor_implausible = 0;
+    } else if (supervisor_implausible < SUPERVISOR_NTC) {
+        supervisor_implausible++;
+    } else {
+        supervisor_trip(SUPERVISOR_SENSOR);
+    }
+
+    if (boiler_duty != BOILER_DUTY_MAX || triac_pump_active()) {
+        supervisor_heat = 0;                        // Restart the rise check.
+    } else if (tick & TICKS_QUARTER) {
+        supervisor_heat++;
+    }
+    if (supervisor_heat == 0) {
+        supervisor_start = adc;
+    } else if (supervisor_heat >= SUPERVISOR_HEAT) {
+        if ((int) (adc - supervisor_start) < SUPERVISOR_RISE) {
+            supervisor_trip(SUPERVISOR_HEATING);
+        }
+        supervisor_heat = 0;
+    }
+}
@@ -0,0 +1,51 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   supervisor.h
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Fault supervisor and watchdog
+ */
+
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#define SUPERVISOR_STALL    50      // Main loop heartbeat timeout (ms, up to 254).
+#define SUPERVISOR_WATCHDOG WDTO_60MS   // Watchdog timeout (65 ms at 5 V).
+#define SUPERVISOR_NTC      100     // Time an implausible NTC value is tolerated (ms, up to 254).
+#define SUPERVISOR_HEAT     60      // Time at full power per temperature rise check (quarter seconds, up to 255).
+#define SUPERVISOR_RISE     24      // Minimum NTC rise per check (12 bit ADC counts, 2 °C cold, 1 °C hot).
+
+// Faults.
+#define SUPERVISOR_OK       0
+#define SUPERVISOR_SENSOR   1       // NTC open, shorted or above the table range.
+#define SUPERVISOR_HEATING  2       // No temperature rise at full heating power.
+#define SUPERVISOR_RESET    3       // Main loop stalled, reset by the watchdog.
+
+extern volatile unsigned char supervisor_fault;     // Detected fault (latched until wake-up).
+extern volatile unsigned char supervisor_heartbeat; // Milliseconds since the last main loop pass.
+
+// Prototypes:
+void supervisor_init(void);                     //  Evaluate the reset cause, start the watchdog.
+void supervisor_sleep(void);                    //  Stop the watchdog for power-down.
+void supervisor_wake(void);                     //  Clear faults, restart the watchdog.
+void supervisor_tick(unsigned char tick);       //  Run the checks (timer interrupt).
+
+#endif
@@ -0,0 +1,58 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   ticks.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Timekeeping
+ *
+ * Timer 1 advances a 16 bit millisecond counter and an 8 bit quarter second
+ * counter. Only the millisecond counter is wider than a byte. The timer
+ * interrupt takes the button hold times as unsigned differences to it, the
+ * trace reads it for time stamps inside an atomic block, and the main loop
+ * waits for the next tick on its low byte. Longer timeouts are counted down
+ * in bytes by the timer interrupt (event timer, AutoOff).
+ */
+
+#include "hal.h"
+#include "ticks.h"
+
+// variables:
+volatile unsigned int ticks_ms;                     // Monotonic milliseconds.
+volatile unsigned char ticks_quarter;               // Quarter seconds.
+static unsigned char ticks_sub;                     // Milliseconds within quarter second.
+
+/**
+ * Advance time by one millisecond. Called from the timer interrupt.
+ *
+ * @return TICKS_QUARTER, TICKS_HALF and TICKS_SECOND flags for the periods starting now.
+ */
+unsigned char ticks_tick(void) {
+    ticks_ms++;
+    if (++ticks_sub < TICKS_PER_QUARTER) {
+        return 0;
+    }
+    ticks_sub = 0;
+    unsigned char quarter = ++ticks_quarter;
+    if (quarter & 1) {
+        return TICKS_QUARTER;
+    }
+    return (quarter & 2) ? TICKS_QUARTER | TICKS_HALF : TICKS_QUARTER | TICKS_HALF | TICKS_SECOND;
+}
@@ -0,0 +1,41 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   ticks.h
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Timekeeping
+ */
+
+#ifndef TICKS_H
+#define TICKS_H
+
+#define TICKS_PER_QUARTER   250     // Milliseconds per quarter second.
+#define TICKS_QUARTER       0x01    // ticks_tick() flag: new quarter second.
+#define TICKS_HALF          0x02    // ticks_tick() flag: new half second.
+#define TICKS_SECOND        0x04    // ticks_tick() flag: new second.
+
+extern volatile unsigned int ticks_ms;          // Monotonic milliseconds (wrapping, ISR only).
+extern volatile unsigned char ticks_quarter;    // Quarter seconds (wrapping).
+
+// Prototypes:
+unsigned char ticks_tick(void);                 //  Advance by 1 ms (timer interrupt).
+
+#endif
@@ -0,0 +1,105 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   ntc_table.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  NTC lookup table generator (build host)
+ *
+ * Computes the temperature of the NTC (to VCC, series resistor to GND) at
+ * NTC_TABLE_POINTS equidistant 12 bit ADC values from the beta equation and
+ * writes them as a header for ntc.c. Temperatures are in 1/16 °C and clamped
+ * to 0..NTC_TABLE_MAX °C. The interpolation in ntc.c multiplies the step
+ * between two points by up to 7 bits, so the generator fails if a step
+ * would overflow 16 bits. The ADC values at NTC_PLAUSIBLE_MIN and
+ * NTC_TABLE_MAX °C bound the plausible readings for the fault supervisor,
+ * an open NTC reads below, a shorted one above.
+ *
+ * Usage: ntc_table R25 BETA RSERIES > ntc_table.h
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NTC_TABLE_SHIFT     7       // ADC bits per table step.
+#define NTC_TABLE_POINTS    ((4096 >> NTC_TABLE_SHIFT) + 1)
+#define NTC_TABLE_FULL      4092    // Full scale of the oversampled ADC value (4 x 1023).
+#define NTC_TABLE_MAX       150     // Upper clamp (°C).
+#define NTC_TABLE_FRAC      16      // Table units per °C.
+#define NTC_PLAUSIBLE_MIN   -20     // Lowest plausible temperature (°C).
+
+/**
+ * Temperature of the NTC at an ADC value.
+ *
+ * @return Temperature in table units, clamped.
+ */
+static long ntc_point(double r25, double beta, double rs, long adc) {
+    if (adc <= 0) {
+        return 0;
+    }
+    if (adc >= NTC_TABLE_FULL) {
+        return NTC_TABLE_MAX * NTC_TABLE_FRAC;
+    }
+    double r = rs * ((double) NTC_TABLE_FULL / adc - 1);
+    double t = 1 / (1 / 298.15 + log(r / r25) / beta) - 273.15;
+    if (t < 0) {
+        t = 0;
+    } else if (t > NTC_TABLE_MAX) {
+        t = NTC_TABLE_MAX;
+    }
+    return lround(t * NTC_TABLE_FRAC);
+}
+
+/**
+ * ADC value of the NTC at a temperature.
+ *
+ * @return Oversampled ADC value.
+ */
+static long ntc_adc(double r25, double beta, double rs, double t) {
+    double r = r25 * exp(beta * (1 / (t + 273.15) - 1 / 298.15));
+    return lround(NTC_TABLE_FULL * rs / (rs + r));
+}
+
+int main(int argc, char **argv) {
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s R25 BETA RSERIES\n", argv[0]);
+        return 1;
+    }
+    double r25 = atof(argv[1]), beta = atof(argv[2]), rs = atof(argv[3]);
+
+    printf("// Generated by tools/ntc_table (R25 = %s, B = %s, RS = %s), do not edit.\n\n", argv[1], argv[2], argv[3]);
+    printf("#define NTC_TABLE_SHIFT     %d\n", NTC_TABLE_SHIFT);
+    printf("#define NTC_ADC_MIN         %-7ld // %d °C\n", ntc_adc(r25, beta, rs, NTC_PLAUSIBLE_MIN), NTC_PLAUSIBLE_MIN);
+    printf("#define NTC_ADC_MAX         %-7ld // %d °C\n\n", ntc_adc(r25, beta, rs, NTC_TABLE_MAX), NTC_TABLE_MAX);
+    printf("static const unsigned int ntc_table[%d] PROGMEM = {", NTC_TABLE_POINTS);
+    long last = 0;
+    for (long i = 0; i < NTC_TABLE_POINTS; i++) {
+        long point = ntc_point(r25, beta, rs, i << NTC_TABLE_SHIFT);
+        if (point - last >= 65536 >> NTC_TABLE_SHIFT) {
+            fprintf(stderr, "ntc_table: step at %ld too large for interpolation\n", i);
+            return 1;
+        }
+        last = point;
+        printf("%s%s%5ld", i ? "," : "", i % 8 ? " " : "\n    ", point);
+    }
+    printf("\n};\n");
+    return 0;
+}
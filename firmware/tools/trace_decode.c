@@ -0,0 +1,170 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   trace_decode.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Trace decoder (build host)
+ *
+ * Reads the bytes captured from the trace output (2400 baud 8N1 on MISO of
+ * the ISP header, or -t of the simulator) and prints one CSV line per
+ * record. A capture started in the middle of a record is aligned by trying
+ * all four byte offsets and keeping the one with the most plausible
+ * records. The 16 bit millisecond timestamps are unwrapped.
+ *
+ * Usage: trace_decode [-t] [FILE]
+ *
+ * -t prints a readable timeline instead of CSV.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../events.h"
+#include "../main.h"
+#include "../trace.h"
+#include "../zerocross.h"
+
+#define DECODE_MAX          (1L << 20)  // Bytes read at most.
+#define DECODE_GAP_MS       1000        // Larger gaps between records count as implausible.
+
+static const char *record_names[] = {"lost", "state", "zc", "ntc", "hall", "temp", "pump", "boiler",
+        "ready", "brew", "cup_boiler", "cup_pump", "heat_boiler", "session_boiler",
+        "session_pump", "scale"};
+static const char *coffee_names[] = {"none", "1 espresso", "2 espressos", "1 coffee", "2 coffees"};
+static const char *state_names[] = {"off", "idle", "heating", "ready", "brewing", "rinsing", "water_empty", "fault",
+        "descaling"};
+static const char *event_names[] = {"none", "power", "1_cup", "1_cup_long", "2_cup", "2_cup_long", "clean",
+        "timer", "water_low", "temp_low", "temp_ok", "dosed", "temp_band", "fault", "descale"};
+
+static unsigned char data[DECODE_MAX];
+
+/**
+ * @return Number of plausible records when decoding from the given offset.
+ */
+static long score(long len, int offset) {
+    long good = 0;
+    unsigned int last = 0;
+    for (long i = offset; i + TRACE_RECORD <= len; i += TRACE_RECORD) {
+        unsigned int ms = data[i] | data[i + 1] << 8;
+        good += (data[i + 3] >> 4) <= TR_LAST && (unsigned int) (ms - last) % 0x10000 < DECODE_GAP_MS;
+        last = ms;
+    }
+    return good;
+}
+
+/**
+ * Describe a record value.
+ */
+static void describe(char *text, size_t size, unsigned char type, unsigned int value) {
+    unsigned char event = value >> 4, next = value & 0x0F;
+    switch (type) {
+        case TR_LOST:
+            snprintf(text, size, "%u records lost", value);
+            break;
+        case TR_STATE:
+            snprintf(text, size, "%s -> %s", event < sizeof(event_names) / sizeof(event_names[0])
+                    ? event_names[event] : "?", next == (M_ANY & 0x0F) ? "(stay)"
+                    : next < sizeof(state_names) / sizeof(state_names[0]) ? state_names[next] : "?");
+            break;
+        case TR_ZC:
+            snprintf(text, size, "%.2f Hz", value ? (double) ZC_TICKS_PER_SEC / (2 * value) : 0);
+            break;
+        case TR_NTC:
+            snprintf(text, size, "%u/4095", value);
+            break;
+        case TR_HALL:
+            snprintf(text, size, "%u/1023", value);
+            break;
+        case TR_TEMP:
+            snprintf(text, size, "%.2f C", value / 16.0);
+            break;
+        case TR_PUMP:
+            snprintf(text, size, "stroke %u", value & 0xFF);
+            break;
+        case TR_BOILER:
+            snprintf(text, size, "boiler %s", value ? "on" : "off");
+            break;
+        case TR_READY:
+            snprintf(text, size, "ready after %.2f s", value / 4.0);
+            break;
+        case TR_BREW:
+            snprintf(text, size, "%s in %.2f s", (value >> 8) <= TWO_COFFEE ? coffee_names[value >> 8] : "?",
+                    (value & 0xFF) / 4.0);
+            break;
+        case TR_CUP_BOILER:
+        case TR_CUP_PUMP:
+            snprintf(text, size, "%u half-cycles", 2 * value);
+            break;
+        case TR_HEAT_BOILER:
+            snprintf(text, size, "%u half-cycles", 16 * value);
+            break;
+        case TR_SESSION_BOILER:
+        case TR_SESSION_PUMP:
+            snprintf(text, size, "%u half-cycles", 256 * value);
+            break;
+        case TR_SCALE:
+            snprintf(text, size, "heating rate %.2f C/s", value / 64.0);
+            break;
+        default:
+            snprintf(text, size, "?");
+            break;
+    }
+}
+
+int main(int argc, char **argv) {
+    int timeline = 0, a = 1;
+    if (a < argc && !strcmp(argv[a], "-t")) {
+        timeline = 1;
+        a++;
+    }
+    FILE *file = a < argc ? fopen(argv[a], "rb") : stdin;
+    if (!file || a + 1 < argc) {
+        fprintf(stderr, "Usage: %s [-t] [FILE]\n", argv[0]);
+        return 2;
+    }
+    long len = fread(data, 1, DECODE_MAX, file);
+
+    int offset = 0;
+    for (int o = 1; o < TRACE_RECORD; o++) {
+        if (score(len, o) > score(len, offset)) {
+            offset = o;
+        }
+    }
+
+    unsigned long time = 0;
+    if (!timeline) {
+        printf("time_ms,record,value,text\n");
+    }
+    for (long i = offset; i + TRACE_RECORD <= len; i += TRACE_RECORD) {
+        unsigned int ms = data[i] | data[i + 1] << 8;
+        unsigned int word = data[i + 2] | data[i + 3] << 8;
+        unsigned char type = word >> 12;
+        unsigned int value = word & 0x0FFF;
+        char text[64];
+        time = ((time & ~0xFFFFUL) | ms) < time ? ((time & ~0xFFFFUL) | ms) + 0x10000 : (time & ~0xFFFFUL) | ms;
+        describe(text, sizeof(text), type, value);
+        if (timeline) {
+            printf("%9.3f  %-14s  %s\n", time / 1000.0, type <= TR_LAST ? record_names[type] : "?", text);
+        } else {
+            printf("%lu,%s,%u,%s\n", time, type <= TR_LAST ? record_names[type] : "?", value, text);
+        }
+    }
+    return 0;
+}
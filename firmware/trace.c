@@ -0,0 +1,193 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   trace.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Binary event trace
+ *
+ * Records are appended to a small ring buffer from interrupts and the main
+ * loop and streamed out as 8N1 UART on MISO of the ISP header. The pin is
+ * OC1A, so every bit edge is set by the timer 1 compare unit in hardware
+ * and interrupt latency does not disturb the bit timing: the compare
+ * interrupt only prepares the level and time of the next edge. Records
+ * which do not fit into the buffer are counted and reported by a TR_LOST
+ * record.
+ *
+ * Without TRACE the module compiles to nothing and all trace() calls vanish.
+ */
+
+#include "hal.h"
+#include "main.h"
+
+#if TRACE
+
+#include "adc.h"
+#include "ntc.h"
+#include "ticks.h"
+#include "trace.h"
+#include "triac.h"
+#include "zerocross.h"
+
+#define TRACE_SET           ((1 << COM1A1) | (1 << COM1A0))     // OC1A high on next compare.
+#define TRACE_CLEAR         (1 << COM1A1)                       // OC1A low on next compare.
+
+// variables:
+static unsigned char trace_buffer[TRACE_SIZE];  // Record bytes.
+static volatile unsigned char trace_head;       // Write index (wrapping).
+static volatile unsigned char trace_tail;       // Read index (wrapping).
+static unsigned int trace_lost;                 // Dropped records.
+static unsigned int trace_shift;                // Bits of the current frame still to schedule.
+static unsigned char trace_idle;                // Buffer found empty at last compare.
+static unsigned char trace_quarter;             // Quarter second of last sensor sample.
+static unsigned char trace_sensor = TR_BOILER;  // Next sensor record type.
+
+/**
+ * Set the output to idle level.
+ */
+void trace_init(void) {
+    TCCR1A = TRACE_SET | (1 << FOC1A);
+    set_bit(TRACE_TX_ddr, TRACE_TX_pin);
+}
+
+/**
+ * Schedule the next bit of the frame, load the next byte after the stop bit.
+ *
+ * @return 0 if the buffer is empty.
+ */
+static unsigned char trace_bit(void) {
+    unsigned int shift = trace_shift;
+    if (!shift) {
+        if (trace_tail == trace_head) {
+            return 0;
+        }
+        shift = 0x200 | (trace_buffer[trace_tail & (TRACE_SIZE - 1)] << 1);    // Stop, data, start bit.
+        trace_tail++;
+    }
+    TCCR1A = (shift & 1) ? TRACE_SET : TRACE_CLEAR;
+    trace_shift = shift >> 1;
+    return 1;
+}
+
+/**
+ * Write a record into the buffer.
+ */
+static void trace_write(unsigned char type, unsigned int value) {
+    unsigned int time = ticks_ms;
+    unsigned char head = trace_head;
+    trace_buffer[head++ & (TRACE_SIZE - 1)] = time;
+    trace_buffer[head++ & (TRACE_SIZE - 1)] = time >> 8;
+    trace_buffer[head++ & (TRACE_SIZE - 1)] = value;
+    trace_buffer[head++ & (TRACE_SIZE - 1)] = (type << 4) | ((value >> 8) & 0x0F);
+    trace_head = head;
+}
+
+/**
+ * Append a record and start the transmitter if it is idle.
+ *
+ * @param type  Record type (TR_*).
+ * @param value Value (12 bit).
+ */
+void trace_put(unsigned char type, unsigned int value) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        unsigned char used = trace_head - trace_tail;
+        if (trace_lost && used <= TRACE_SIZE - 2 * TRACE_RECORD) {
+            trace_write(TR_LOST, trace_lost);
+            trace_lost = 0;
+            used += TRACE_RECORD;
+        }
+        if (used <= TRACE_SIZE - TRACE_RECORD) {
+            trace_write(type, value);
+            if (!(TIMSK & (1 << OCIE1A))) {             // Transmitter idle: start bit shortly.
+                unsigned char next = TCNT1 + 8;           // Well after the setup below.
+                OCR1A = (next > TIMER1_TOP) ? next - (TIMER1_TOP + 1) : next;
+                trace_bit();
+                TIFR = (1 << OCF1A);                    // Clear stale compare flag.
+                set_bit(TIMSK, OCIE1A);
+            }
+        } else if (trace_lost < 0x0FFF) {
+            trace_lost++;
+        }
+    }
+}
+
+/**
+ * Record one sensor value per call, starting over every quarter second.
+ */
+void trace_sample(void) {
+    if (!(TRACE & TRACE_SENSORS)) {
+        return;
+    }
+    if (trace_quarter != ticks_quarter) {
+        trace_quarter = ticks_quarter;
+        trace_sensor = TR_ZC;
+    }
+    // Sensor values can wait, keep two records free for events (e.g. button and transition).
+    if (trace_sensor == TR_BOILER || (unsigned char) (trace_head - trace_tail) > TRACE_SIZE - 3 * TRACE_RECORD) {
+        return;
+    }
+    unsigned int value;
+    switch (trace_sensor) {
+        case TR_ZC:
+            value = zc_period();
+            break;
+        case TR_NTC:
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                value = adc_decimated;
+            }
+            break;
+        case TR_HALL:
+            value = adc_magnet();
+            break;
+        case TR_TEMP:
+            value = ntc_temperature;
+            break;
+        default:
+            value = triac_strokes;
+            break;
+    }
+    trace_put(trace_sensor++, value);
+}
+
+/**
+ * Wait until the transmitter is idle, e.g. before the clock stops in power-down.
+ */
+void trace_flush(void) {
+    while (is_set(TIMSK, OCIE1A)) {
+        hal_yield();
+    }
+}
+
+/**
+ * Compare match: the scheduled edge has just been output, prepare the next one.
+ */
+ISR ( TIMER1_COMPA_vect) {
+    unsigned char next = OCR1A + TRACE_BIT_TICKS;
+    OCR1A = (next > TIMER1_TOP) ? next - (TIMER1_TOP + 1) : next;
+    if (trace_bit()) {
+        trace_idle = 0;
+    } else if (trace_idle) {                            // Stop bit complete, line stays idle.
+        clear_bit(TIMSK, OCIE1A);
+    } else {
+        trace_idle = 1;
+    }
+}
+
+#endif
@@ -0,0 +1,84 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   trace.h
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Binary event trace
+ *
+ * Record layout (4 bytes, little endian): time in ms (16 bit, wrapping),
+ * then type << 12 | value (16 bit). Also included by the host decoder.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+// Trace classes (bits of TRACE).
+#define TRACE_STATE         0x01    // State machine transitions.
+#define TRACE_SENSORS       0x02    // Zero crossing, NTC, hall, temperature and pump strokes every quarter second.
+#define TRACE_BOILER        0x04    // Boiler triac edges.
+#define TRACE_ENERGY        0x08    // Heat-up time and rate, brew and session totals.
+
+// Record types.
+#define TR_LOST             0       // Records dropped on overflow (count).
+#define TR_STATE            1       // Transition: event << 4 | next state (0xF: no state change).
+#define TR_ZC               2       // Half-cycle period (timer 1 ticks).
+#define TR_NTC              3       // Oversampled NTC value (12 bit).
+#define TR_HALL             4       // Hall sensor (10 bit).
+#define TR_TEMP             5       // Filtered temperature (1/16 °C).
+#define TR_PUMP             6       // Pump strokes fired (8 bit, wrapping).
+#define TR_BOILER           7       // Boiler triac: 1 on, 0 off.
+#define TR_READY            8       // Wake-up to ready (quarter seconds).
+#define TR_BREW             9       // Brew duration: coffee mode << 8 | quarter seconds.
+#define TR_CUP_BOILER       10      // Boiler on during the brew (mains cycles).
+#define TR_CUP_PUMP         11      // Pump fired during the brew (mains cycles).
+#define TR_HEAT_BOILER      12      // Boiler on from wake-up to ready (16 half-cycles).
+#define TR_SESSION_BOILER   13      // Boiler on since wake-up (256 half-cycles).
+#define TR_SESSION_PUMP     14      // Pump fired since wake-up (256 half-cycles).
+#define TR_SCALE            15      // Heating rate of a heat-up from cold (1/64 °C per second on-time).
+#define TR_LAST             TR_SCALE
+
+#define TRACE_RECORD        4       // Bytes per record.
+#define TRACE_SIZE          16      // Ring buffer (bytes, power of 2).
+#define TRACE_BAUD          2400    // Serial bit rate.
+#define TRACE_BIT_TICKS     ((1000000UL / TIMER1_TICK_US + TRACE_BAUD / 2) / TRACE_BAUD)    // Bit time in timer 1 ticks.
+#if TRACE_BIT_TICKS * TIMER1_TICK_US * TRACE_BAUD > 1020000UL || TRACE_BIT_TICKS * TIMER1_TICK_US * TRACE_BAUD < 980000UL
+#error "TRACE_BAUD: bit time off by more than 2%"
+#endif
+#if TIMER1_TOP + TRACE_BIT_TICKS > 255
+#error "TRACE_BAUD: bit time exceeds the 8 bit compare arithmetic"
+#endif
+
+#if TRACE
+#define trace(class, type, value)   do { if (TRACE & (class)) trace_put((type), (value)); } while (0)
+
+// Prototypes:
+void trace_init(void);                                  //  Idle level on the output.
+void trace_put(unsigned char type, unsigned int value); //  Append a record (any context).
+void trace_sample(void);                                //  Record sensors (main loop).
+void trace_flush(void);                                 //  Wait until all records are sent.
+#else
+#define trace(class, type, value)   do {} while (0)
+#define trace_init()                do {} while (0)
+#define trace_sample()              do {} while (0)
+#define trace_flush()               do {} while (0)
+#endif
+
+#endif
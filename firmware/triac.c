@@ -0,0 +1,148 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   triac.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Timer scheduled triac gate pulses
+ *
+ * The pulse is timed from the crossing the zero crossing PLL predicts, not
+ * from the ADC sample that entered the zero window: that sample lags the
+ * window edge by up to one scan round, the prediction does not. Timer 0
+ * runs in 8 bit mode as a one-shot timer from zero. Compare match A first
+ * asserts the gate (end of phase delay), then OCR0A is advanced by the
+ * pulse width and the next match releases the gate and stops the timer.
+ * Both edges are counted by the hardware from the previous match, so the
+ * interrupt latency does not add to the width.
+ */
+
+#include "hal.h"
+#include "main.h"
+#include "events.h"
+#include "triac.h"
+
+// variables:
+static volatile unsigned char gate_width;   // Pulse width still to be scheduled (ticks).
+static volatile unsigned char pump_duty;    // Pump pulses per 255 half-cycles.
+static unsigned char pump_sigma;            // Pulse skip modulator accumulator.
+static volatile unsigned int pump_left;     // Strokes left to dose.
+volatile unsigned char triac_strokes;       // Pump strokes fired (wrapping).
+
+/**
+ * Schedule a gate pulse for the pump triac.
+ * The pulse starts after the given delay and lasts PUMP_GATE_WIDTH.
+ * Calls while a pulse is pending are ignored.
+ *
+ * @param delay Phase delay (timer 0 ticks, 0 to fire immediately).
+ */
+void triac_pump_pulse(unsigned char delay) {
+    if (TCCR0B & TRIAC_PRESCALER) {                 // Pulse pending.
+        return;
+    }
+
+    TCNT0L = 0;
+    if (delay == 0) {                               // Fire immediately.
+        clear_bit(TRIAC_PUMP_w, TRIAC_PUMP_pin);
+        gate_width = 0;
+        OCR0A = PUMP_GATE_WIDTH_TICKS;
+    } else {                                        // Wait for phase delay first.
+        gate_width = PUMP_GATE_WIDTH_TICKS;
+        OCR0A = delay;
+    }
+    TCCR0B = (1 << PSR0) | TRIAC_PRESCALER;         // Reset prescaler and start timer.
+}
+
+/**
+ * Set the pump duty cycle. Pulses are skipped by a first order sigma-delta
+ * modulator, 255 fires on every half-cycle, 0 stops the pump.
+ * Stopping does not cut a pulse which is already scheduled.
+ *
+ * @param duty Pulses per 255 half-cycles.
+ */
+void triac_pump_run(unsigned char duty) {
+    pump_duty = duty;
+}
+
+/**
+ * @return Pump duty cycle, 0 if the pump is not running.
+ */
+unsigned char triac_pump_active(void) {
+    unsigned char dosing;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {             // Decremented by the ADC interrupt.
+        dosing = pump_left != 0;
+    }
+    return dosing ? pump_duty : 0;
+}
+
+/**
+ * Set the number of pump strokes to deliver. Once the dose is complete,
+ * no further pulses are fired and EV_DOSED is posted.
+ *
+ * @param strokes Stroke count, TRIAC_UNLIMITED for no limit.
+ */
+void triac_pump_dose(unsigned int strokes) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        pump_left = strokes;
+    }
+}
+
+/**
+ * Cancel any scheduled pulse and switch the pump triac off.
+ */
+void triac_pump_stop(void) {
+    pump_duty = 0;
+    gate_width = 0;                                 // Pending overflow can only release the gate.
+    TCCR0B = 0;                                     // Stop timer.
+    set_bit(TRIAC_PUMP_w, TRIAC_PUMP_pin);          // Pump off.
+}
+
+/**
+ * Zero window entered. Called from the ADC interrupt.
+ *
+ * @param lead Time to the predicted crossing (timer 1 ticks, 0 if the PLL is not locked).
+ */
+void triac_zero_crossing(unsigned int lead) {
+    unsigned char sigma = pump_sigma;
+    pump_sigma += pump_duty;
+    if ((pump_sigma < sigma || pump_duty == 255) && pump_left && !(TCCR0B & TRIAC_PRESCALER)) {
+        if (lead > TRIAC_LEAD_MAX / TIMER1_TICK_US) {   // Crossing already passed or prediction off.
+            lead = 0;
+        }
+        triac_pump_pulse(TRIAC_TICKS(lead * TIMER1_TICK_US + PUMP_GATE_DELAY));
+        triac_strokes++;
+        if (pump_left != TRIAC_UNLIMITED && --pump_left == 0) {
+            event_post(EV_DOSED);                   // Dose complete.
+        }
+    }
+}
+
+/**
+ * Timer 0 compare match A. Asserts or releases the gate.
+ */
+ISR ( TIMER0_COMPA_vect) {
+    if (gate_width) {                               // Phase delay elapsed:
+        clear_bit(TRIAC_PUMP_w, TRIAC_PUMP_pin);    // Assert gate.
+        OCR0A += gate_width;                        // Release one pulse width after this match.
+        gate_width = 0;
+    } else {                                        // Pulse width elapsed:
+        set_bit(TRIAC_PUMP_w, TRIAC_PUMP_pin);      // Release gate.
+        TCCR0B = 0;                                 // Stop timer.
+    }
+}
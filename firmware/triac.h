@@ -0,0 +1,67 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   triac.h
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Timer scheduled triac gate pulses
+ */
+
+#ifndef TRIAC_H
+#define TRIAC_H
+
+// Timer 0 runs while a pulse is scheduled, with the smallest prescaler that fits the gate timing into 8 bit.
+#define TRIAC_LEAD_MAX      2000    // Longest wait from zero window entry to the predicted crossing (us).
+#define TRIAC_GATE_MAX      (PUMP_GATE_WIDTH > PUMP_GATE_DELAY + TRIAC_LEAD_MAX ? PUMP_GATE_WIDTH \
+                             : PUMP_GATE_DELAY + TRIAC_LEAD_MAX)
+#if TRIAC_GATE_MAX * (F_CPU / 1000000UL) / 8 < 256
+#define TRIAC_DIVISION      8
+#define TRIAC_PRESCALER     ((1 << CS01))
+#elif TRIAC_GATE_MAX * (F_CPU / 1000000UL) / 64 < 256
+#define TRIAC_DIVISION      64
+#define TRIAC_PRESCALER     ((1 << CS01) | (1 << CS00))
+#elif TRIAC_GATE_MAX * (F_CPU / 1000000UL) / 256 < 256
+#define TRIAC_DIVISION      256
+#define TRIAC_PRESCALER     ((1 << CS02))
+#else
+#error "F_CPU: pump gate timing does not fit timer 0"
+#endif
+#define TRIAC_TICK_US       (TRIAC_DIVISION / (F_CPU / 1000000UL))
+
+// Gate timing in timer ticks (1..255).
+#define TRIAC_TICKS(us)         (((us) + TRIAC_TICK_US / 2) / TRIAC_TICK_US)
+#define PUMP_GATE_WIDTH_TICKS   TRIAC_TICKS(PUMP_GATE_WIDTH)
+#if PUMP_GATE_WIDTH_TICKS == 0
+#error "PUMP_GATE_WIDTH shorter than one timer 0 tick"
+#endif
+
+#define TRIAC_UNLIMITED     0xFFFF  // Pump dose without limit.
+
+extern volatile unsigned char triac_strokes;    // Pump strokes fired (wrapping).
+
+// Prototypes:
+void triac_pump_pulse(unsigned char delay);     //  Schedule a pump gate pulse.
+void triac_pump_run(unsigned char duty);        //  Fire pump on zero crossings (duty 0..255).
+void triac_pump_dose(unsigned int strokes);     //  Limit pump strokes.
+unsigned char triac_pump_active(void);          //  Current pump duty (0 if off).
+void triac_pump_stop(void);                     //  Cancel pulse and release the gate.
+void triac_zero_crossing(unsigned int lead);    //  Zero window entered.
+
+#endif
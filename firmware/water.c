@@ -0,0 +1,80 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   water.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Tank level and remaining water estimate
+ *
+ * The hall sensor only covers the bottom of the tank: between WATER_LOW and
+ * WATER_FULL its reading follows the float, above it the reading saturates.
+ * The remaining water is therefore estimated from the pump strokes fired
+ * since the last refill and corrected by the sensor:
+ *   - within the sensing range, the reading is interpolated to the volume,
+ *   - above it, at least WATER_FULL_ML are left.
+ * A refill is recognized when the level rises from below WATER_LOW to
+ * WATER_OK (empty tank refilled, or tank lifted off) and assumes a full
+ * tank, as does power-up.
+ */
+
+#include "hal.h"
+#include "main.h"
+#include "adc.h"
+#include "triac.h"
+#include "water.h"
+
+#define WATER_TANK_STROKES  ((unsigned int) TANK_VOLUME * PULSES_PER_ML)
+#define WATER_FULL_STROKES  ((unsigned int) WATER_FULL_ML * PULSES_PER_ML)
+#if TANK_VOLUME * PULSES_PER_ML > 65535 || (WATER_FULL - WATER_LOW) * WATER_FULL_ML > 32767
+#error "TANK_VOLUME, WATER_FULL_ML: stroke estimate exceeds 16 bit"
+#endif
+
+// variables:
+unsigned int water_left;                        // Estimated water above WATER_LOW (strokes).
+static unsigned char water_strokes;             // Pump strokes accounted for.
+static unsigned char water_ok;                  // Level above low threshold (with hysteresis).
+
+/**
+ * Update the level state and the estimate. Called from the main loop.
+ *
+ * @return Non-zero if the water level is OK.
+ */
+unsigned char water_update(void) {
+    unsigned char sense = adc_magnet() >> 2;
+
+    unsigned char strokes = triac_strokes - water_strokes;
+    water_strokes += strokes;
+    water_left = (water_left > strokes) ? water_left - strokes : 0;
+
+    if (water_ok ? (sense <= WATER_LOW) : (sense >= WATER_OK)) {
+        water_ok = !water_ok;
+        if (water_ok) {                                 // Refilled.
+            water_left = WATER_TANK_STROKES;
+        }
+    }
+
+    if (sense < WATER_FULL) {                           // Level within sensing range.
+        water_left = (sense > WATER_LOW)
+                     ? (sense - WATER_LOW) * WATER_FULL_ML / (WATER_FULL - WATER_LOW) * PULSES_PER_ML : 0;
+    } else if (water_left < WATER_FULL_STROKES) {
+        water_left = WATER_FULL_STROKES;
+    }
+    return water_ok;
+}
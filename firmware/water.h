@@ -0,0 +1,35 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   water.h
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Tank level and remaining water estimate
+ */
+
+#ifndef WATER_H
+#define WATER_H
+
+extern unsigned int water_left;                 // Estimated water above WATER_LOW (strokes).
+
+// Prototypes:
+unsigned char water_update(void);               //  Track level, non-zero if water is OK.
+
+#endif
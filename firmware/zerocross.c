@@ -0,0 +1,175 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   zerocross.c
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Mains locked zero crossing tracker
+ *
+ * The rectified mains signal dips below ZERO_CROSSING_LOW around every zero
+ * crossing. Entering that window (with hysteresis up to ZERO_CROSSING_HIGH)
+ * counts one half-cycle and triggers the pump gate and boiler modulation. The center of the window
+ * is timestamped against timer 1 and fed into a software PLL, which detects
+ * 50/60 Hz, tracks the period and predicts the next crossing. The pump gate
+ * is timed from that prediction.
+ */
+
+#include "hal.h"
+#include "main.h"
+#include "boiler.h"
+#include "triac.h"
+#include "zerocross.h"
+
+// variables:
+volatile unsigned int zc_time_base;                 // Timer 1 ticks at last overflow.
+volatile unsigned char zc_half_cycles;              // Detected half-cycles (wrapping).
+static unsigned char zc_window;                     // Signal inside zero window.
+static unsigned int zc_enter;                       // Timestamp of window entry.
+static unsigned int zc_last;                        // Timestamp of last crossing.
+static unsigned int zc_predicted;                   // Predicted next crossing.
+static unsigned int zc_period_q;                    // Period estimate (fixed point).
+static unsigned int zc_peak_error;                  // Peak phase error (ticks).
+static unsigned char zc_hz;                         // Detected frequency, 0 if unlocked.
+static unsigned char zc_slips;                      // Consecutive out-of-lock crossings.
+static unsigned char zc_started;                    // Last crossing timestamp is valid.
+
+/**
+ * Get current time. Must be called with interrupts disabled.
+ *
+ * @return Timer 1 ticks (wrapping).
+ */
+unsigned int zc_timestamp(void) {
+    unsigned char ticks = TCNT1;
+    unsigned int base = zc_time_base;
+    if ((TIFR & (1 << TOV1)) && ticks < (TIMER1_TOP / 2)) {  // Overflow pending.
+        base += TIMER1_TOP + 1;
+    }
+    return base + ticks;
+}
+
+/**
+ * Feed a crossing timestamp into the PLL.
+ *
+ * @param time Center of the zero window (timer 1 ticks).
+ */
+static void zc_track(unsigned int time) {
+    unsigned int measured = time - zc_last;
+    zc_last = time;
+
+    if (zc_hz == 0) {                                           // Not locked: detect frequency.
+        if (!zc_started) {                                      // First crossing, nothing to measure from.
+            zc_started = 1;
+            return;
+        }
+        if (measured > ZC_PERIOD_50HZ - ZC_CAPTURE(ZC_PERIOD_50HZ) &&
+            measured < ZC_PERIOD_50HZ + ZC_CAPTURE(ZC_PERIOD_50HZ)) {
+            zc_hz = 50;
+            zc_period_q = ZC_PERIOD_50HZ << ZC_PERIOD_SHIFT;
+        } else if (measured > ZC_PERIOD_60HZ - ZC_CAPTURE(ZC_PERIOD_60HZ) &&
+                   measured < ZC_PERIOD_60HZ + ZC_CAPTURE(ZC_PERIOD_60HZ)) {
+            zc_hz = 60;
+            zc_period_q = ZC_PERIOD_60HZ << ZC_PERIOD_SHIFT;
+        } else {
+            return;
+        }
+        zc_slips = 0;
+        zc_predicted = time + (zc_period_q >> ZC_PERIOD_SHIFT);
+        return;
+    }
+
+    int error = (int) (time - zc_predicted);
+    unsigned int period = zc_period_q >> ZC_PERIOD_SHIFT;
+    unsigned int magnitude = error < 0 ? -error : error;
+
+    if (magnitude > (period >> 2)) {                            // Missed or spurious crossing:
+        if (++zc_slips >= ZC_UNLOCK) {                          // Drop lock after repeated slips.
+            zc_hz = 0;
+        }
+        zc_predicted = time + period;                           // Resync phase, keep period.
+        return;
+    }
+    zc_slips = 0;
+
+    if (magnitude > zc_peak_error) {                            // Jitter statistic.
+        zc_peak_error = magnitude;
+    }
+
+    zc_period_q += error * (1 << ZC_PERIOD_SHIFT) / 8;                 // Frequency correction (1/8).
+    zc_predicted += (zc_period_q >> ZC_PERIOD_SHIFT) + (error >> 1);   // Phase correction (1/2).
+}
+
+/**
+ * Process a zero crossing sample. Called from the ADC interrupt.
+ *
+ * @param value Raw ADC value.
+ */
+void zc_sample(unsigned int value) {
+    if (zc_window) {
+        if (value >= ZERO_CROSSING_HIGH) {                      // Leaving zero window.
+            zc_window = 0;
+            unsigned int now = zc_timestamp();
+            zc_track(zc_enter + ((now - zc_enter) >> 1));
+        }
+    } else if (value <= ZERO_CROSSING_LOW) {                    // Entering zero window.
+        zc_window = 1;
+        zc_enter = zc_timestamp();
+        zc_half_cycles++;
+        triac_zero_crossing(zc_hz ? zc_predicted - zc_enter : 0);
+        boiler_zero_crossing();
+    }
+}
+
+/**
+ * @return Detected mains frequency in Hz, 0 if not locked.
+ */
+unsigned char zc_frequency(void) {
+    return zc_hz;
+}
+
+/**
+ * @return Half-cycle period in timer 1 ticks, 0 if not locked.
+ */
+unsigned int zc_period(void) {
+    unsigned int period;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        period = zc_hz ? (zc_period_q >> ZC_PERIOD_SHIFT) : 0;
+    }
+    return period;
+}
+
+/**
+ * @return Peak absolute phase error since last reset (timer 1 ticks).
+ */
+unsigned int zc_jitter(void) {
+    unsigned int jitter;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        jitter = zc_peak_error;
+    }
+    return jitter;
+}
+
+/**
+ * Reset the jitter statistic.
+ */
+void zc_reset_jitter(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        zc_peak_error = 0;
+    }
+}
@@ -0,0 +1,50 @@
+/*****************************************************************************
+ *  SenseoControl 2.0                                                        *
+ *  Copyright (C) 2013-2026  Stefan Kalscheuer                               *
+ *                                                                           *
+ *  This program is free software: you can redistribute it and/or modify     *
+ *  it under the terms of the GNU General Public License as published by     *
+ *  the Free Software Foundation version 3.                                  *
+ *                                                                           *
+ *  This program is distributed in the hope that it will be useful,          *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of           *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the            *
+ *  GNU General Public License for more details.                             *
+ *                                                                           *
+ *   You should have received a copy of the GNU General Public License       *
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.  *
+ *****************************************************************************/
+
+/**
+ * SenseoControl 2.0
+ *
+ * @file   zerocross.h
+ * @author Stefan Kalscheuer
+ * @date   2026-10-17
+ * @brief  Mains locked zero crossing tracker
+ */
+
+#ifndef ZEROCROSS_H
+#define ZEROCROSS_H
+
+// Timer 1 ticks per second and nominal half-cycle periods.
+#define ZC_TICKS_PER_SEC    (1000UL * (TIMER1_TOP + 1))
+#define ZC_PERIOD_50HZ      (ZC_TICKS_PER_SEC / 100)
+#define ZC_PERIOD_60HZ      (ZC_TICKS_PER_SEC / 120)
+#define ZC_CAPTURE(PERIOD)  ((PERIOD) / 12)     // Capture range for frequency detection (+-8%).
+
+#define ZC_PERIOD_SHIFT     4       // Fractional bits of the period estimate.
+#define ZC_UNLOCK           4       // Consecutive slips until the lock is dropped.
+
+extern volatile unsigned int zc_time_base;      // Timer 1 ticks at last overflow.
+extern volatile unsigned char zc_half_cycles;   // Detected half-cycles (wrapping).
+
+// Prototypes:
+unsigned int zc_timestamp(void);                //  Current time in timer 1 ticks.
+void zc_sample(unsigned int value);             //  Process zero crossing sample.
+unsigned char zc_frequency(void);               //  Detected mains frequency (0 if unlocked).
+unsigned int zc_period(void);                   //  Half-cycle period (timer 1 ticks).
+unsigned int zc_jitter(void);                   //  Peak phase error since last reset.
+void zc_reset_jitter(void);                     //  Reset jitter statistic.
+
+#endif